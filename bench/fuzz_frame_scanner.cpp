@@ -0,0 +1,49 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "frame.hpp"
+#include "status/frame_scanner.hpp"
+#include "utility/crc.hpp"
+
+// libFuzzer entry over FrameScanner::scan. The first input byte picks the read size, the rest is
+// fed in reads of that size, and every frame that comes out must carry a valid header and body.
+// Build with clang and -fsanitize=fuzzer,address.
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    using namespace rmcs_referee;
+
+    if (size == 0)
+        return 0;
+    auto chunk = size_t{data[0]} + 1;
+    ++data, --size;
+
+    status::FrameScanner scanner;
+    Frame frame;
+    while (size) {
+        auto [first, second] = scanner.writable();
+        auto length          = std::min({chunk, size, first.size() + second.size()});
+        if (length == 0)
+            std::abort(); // A full buffer the scanner never drains.
+
+        auto head = std::min(length, first.size());
+        std::memcpy(first.data(), data, head);
+        if (length > head)
+            std::memcpy(second.data(), data + head, length - head);
+        scanner.commit(length, status::FrameScanner::Clock::now());
+        data += length, size -= length;
+
+        while (scanner.scan(frame)) {
+            auto frame_size = sizeof(frame.header) + sizeof(frame.body.command_id)
+                            + frame.header.data_length + sizeof(uint16_t);
+            if (frame.header.sof != sof_value || frame_size > sizeof(frame)
+                || !utility::crc::verify_crc8(frame.header)
+                || !utility::crc::verify_crc16(&frame, frame_size))
+                std::abort();
+        }
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace rmcs_referee::bench {
+
+// In-memory stand-in for the part of serial::Serial the referee code uses. Written bytes are
+// kept for inspection, reads play back a byte stream at most `chunk` bytes at a time, the way
+// the driver hands out what arrived since the last read.
+class MemorySerial {
+public:
+    void load(std::vector<uint8_t> stream, size_t chunk) {
+        rx_       = std::move(stream);
+        position_ = 0;
+        chunk_    = chunk;
+    }
+
+    [[nodiscard]] size_t available() const { return std::min(rx_.size() - position_, chunk_); }
+
+    size_t read(uint8_t* buffer, size_t size) {
+        size = std::min(size, available());
+        std::memcpy(buffer, rx_.data() + position_, size);
+        position_ += size;
+        return size;
+    }
+
+    size_t write(const uint8_t* data, size_t size) {
+        tx_.insert(tx_.end(), data, data + size);
+        return size;
+    }
+
+    [[nodiscard]] bool eof() const { return position_ == rx_.size(); }
+
+    std::vector<uint8_t>& written() { return tx_; }
+
+private:
+    std::vector<uint8_t> rx_, tx_;
+    size_t position_ = 0, chunk_ = 0;
+};
+
+} // namespace rmcs_referee::bench
\ No newline at end of file
@@ -0,0 +1,509 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <rmcs_msgs/robot_id.hpp>
+#include <serial_util/crc/dji_crc.hpp>
+
+#include "app/ui/shape/cfs_scheduler.hpp"
+#include "app/ui/shape/shape.hpp"
+#include "app/ui/widget/crosshair.hpp"
+#include "app/ui/widget/status_ring.hpp"
+#include "command/field.hpp"
+#include "command/interaction/header.hpp"
+#include "command/interaction/shape_packer.hpp"
+#include "command/prepared_frame.hpp"
+#include "command/uplink_frame.hpp"
+#include "frame.hpp"
+#include "memory_serial.hpp"
+#include "status/dispatch.hpp"
+#include "status/field.hpp"
+#include "status/frame_scanner.hpp"
+#include "utility/crc.hpp"
+
+// Feeds synthesized referee streams through the receive path of Status and the send path of
+// Command and Ui, without an executor or any hardware. Prints throughput numbers, and exits with 1
+// when a frame was lost or corrupted on the way, so it also runs as a test.
+// Usage: referee_bench [--quick]
+
+namespace rmcs_referee::bench {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Bytes per second of the 115200 baud referee link.
+constexpr double link_rate = 11520.0;
+
+bool failed = false;
+
+volatile uint32_t crc_sink;
+
+void check(bool condition, const char* what) {
+    if (!condition) {
+        std::printf("FAILED: %s\n", what);
+        failed = true;
+    }
+}
+
+double elapsed_ns(Clock::time_point begin) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - begin).count();
+}
+
+// Decodes what Status decodes, keeping a checksum so that nothing is optimized away.
+struct Receiver {
+    void game_status(const status::GameStatus& data) { sum += data.stage_remain_time; }
+    void robot_status(const status::RobotStatus& data) { sum += data.current_hp; }
+    void power_heat_data(const status::PowerHeatData& data) { sum += data.buffer_energy; }
+    void robot_position(const status::RobotPosition& data) { sum += static_cast<int>(data.x); }
+    void interaction(const command::interaction::Header& data) { sum += data.sender_id; }
+
+    uint64_t sum = 0;
+};
+
+using Table = status::DispatchTable<
+    Receiver, status::FrameHandler<0x0001, status::GameStatus, 11, &Receiver::game_status>,
+    status::FrameHandler<0x0201, status::RobotStatus, 13, &Receiver::robot_status>,
+    status::FrameHandler<0x0202, status::PowerHeatData, 16, &Receiver::power_heat_data>,
+    status::FrameHandler<0x0203, status::RobotPosition, 12, &Receiver::robot_position>,
+    status::FrameHandler<0x0301, command::interaction::Header, 6, &Receiver::interaction>>;
+
+// The receive loop of Status: read what the port has into the scanner, then take every verified
+// frame out of it. Calls `on_frame(frame, fed)` with the number of stream bytes fed so far.
+template <typename F>
+size_t receive(MemorySerial& serial, Receiver& receiver, F&& on_frame) {
+    status::FrameScanner scanner;
+    Frame frame;
+    size_t frames = 0, fed = 0;
+    while (!serial.eof()) {
+        auto [first, second] = scanner.writable();
+        auto size = serial.read(reinterpret_cast<uint8_t*>(first.data()), first.size());
+        if (size == first.size())
+            size += serial.read(reinterpret_cast<uint8_t*>(second.data()), second.size());
+        scanner.commit(size, Clock::now());
+        fed += size;
+
+        while (scanner.scan(frame)) {
+            ++frames;
+            on_frame(frame, fed);
+            auto entry = Table::find(frame.body.command_id);
+            if (entry && frame.header.data_length >= entry->length)
+                entry->invoke(receiver, frame.body.data);
+        }
+    }
+    return frames;
+}
+
+// Best of a few runs, in nanoseconds, of receiving a whole stream in reads of `chunk` bytes.
+double time_receive(const std::vector<uint8_t>& bytes, size_t chunk, size_t& frames) {
+    double best = 0;
+    for (int run = 0; run < 3; ++run) {
+        MemorySerial serial;
+        serial.load(bytes, chunk);
+        Receiver receiver;
+        auto begin = Clock::now();
+        frames     = receive(serial, receiver, [](const Frame&, size_t) {});
+        auto ns    = elapsed_ns(begin);
+        best       = run ? std::min(best, ns) : ns;
+    }
+    return best;
+}
+
+struct Stream {
+    std::vector<uint8_t> bytes;
+    // Offset one past the end of every frame that should come out of the scanner.
+    std::vector<size_t> intact_ends;
+    // Indices into intact_ends of the frames right behind a damaged frame.
+    std::vector<size_t> after_damage;
+    size_t damaged = 0;
+};
+
+enum class Damage { NONE, FLIPPED_BYTE, TRUNCATED, GARBAGE };
+
+// Appends a frame, damaged as asked, returns whether the frame itself still arrives intact.
+// `cut` picks the damaged byte or the length kept.
+bool append_frame(
+    std::vector<uint8_t>& out, const uint8_t* bytes, size_t size, Damage damage, uint32_t cut) {
+    switch (damage) {
+    case Damage::NONE: out.insert(out.end(), bytes, bytes + size); return true;
+    case Damage::FLIPPED_BYTE:
+        out.insert(out.end(), bytes, bytes + size);
+        out[out.size() - size + cut % size] ^= 1u << cut % 8;
+        return false;
+    case Damage::TRUNCATED:
+        // At least the whole crc16 is cut off: with only its last byte missing, the SOF of the next
+        // frame completes it 1 time in 256, which the protocol cannot tell from a good frame.
+        out.insert(out.end(), bytes, bytes + 1 + cut % (size - 2));
+        return false;
+    case Damage::GARBAGE:
+        for (auto garbage = 1 + cut % 32; garbage--; cut = cut * 1103515245 + 12345)
+            out.push_back(cut >> 16 & 3 ? static_cast<uint8_t>(cut >> 8) : sof_value);
+        out.insert(out.end(), bytes, bytes + size);
+        return true;
+    }
+    return false;
+}
+
+// Referee traffic as it is received: mostly power and heat data, with robot status, game status,
+// position and interaction frames in between. One frame in `damage_interval` is damaged: a flipped
+// byte, a truncated tail, or garbage full of SOF candidates inserted in front of it. With
+// `damage_interval` 0, only the frames at `damaged_index` modulo 10 are, all with `damage`.
+Stream synthesize(
+    size_t frame_count, size_t damage_interval, uint32_t seed, Damage damage = Damage::NONE,
+    size_t damaged_index = 8) {
+    struct Kind {
+        uint16_t command_id;
+        size_t data_length;
+    };
+    static constexpr Kind kinds[10] = {
+        {0x0202, 16}, {0x0202, 16}, {0x0201, 13}, {0x0202, 16}, {0x0001, 11},
+        {0x0202, 16}, {0x0203, 12}, {0x0202, 16}, {0x0301, 36}, {0x0202, 16},
+    };
+
+    std::mt19937 random{seed};
+    Stream stream;
+    command::UplinkFrame frame;
+    bool damage_before = false;
+    for (size_t i = 0; i < frame_count; ++i) {
+        auto kind = kinds[i % std::size(kinds)];
+        for (size_t j = 0; j < kind.data_length; ++j)
+            frame.body.data[j] = static_cast<std::byte>(random());
+        auto size  = command::seal_frame(frame, kind.command_id, kind.data_length);
+        auto bytes = reinterpret_cast<const uint8_t*>(&frame);
+
+        auto frame_damage = Damage::NONE;
+        if (damage_interval && random() % damage_interval == 0)
+            frame_damage = static_cast<Damage>(1 + random() % 3);
+        else if (!damage_interval && i % std::size(kinds) == damaged_index)
+            frame_damage = damage;
+
+        auto intact = append_frame(stream.bytes, bytes, size, frame_damage, random());
+        if (intact) {
+            if (damage_before || frame_damage != Damage::NONE)
+                stream.after_damage.push_back(stream.intact_ends.size());
+            stream.intact_ends.push_back(stream.bytes.size());
+        } else {
+            ++stream.damaged;
+        }
+        damage_before = !intact;
+    }
+    return stream;
+}
+
+void bench_parser(bool quick) {
+    std::printf("Status receive path\n");
+    auto frame_count = quick ? size_t{20'000} : size_t{500'000};
+    auto clean       = synthesize(frame_count, 0, 1);
+
+    // Reads of 1 byte, of what a 1kHz tick sees at 115200 baud, and bursts up to the whole ring.
+    for (size_t chunk : {size_t{1}, size_t{12}, size_t{64}, size_t{4096}}) {
+        size_t frames = 0;
+        auto ns       = time_receive(clean.bytes, chunk, frames);
+        check(frames == frame_count, "clean stream lost frames");
+        std::printf(
+            "  clean, %4zu-byte reads: %10.0f frames/s %8.1f ns/frame %8.1f MB/s\n", chunk,
+            frames / ns * 1e9, ns / frames, clean.bytes.size() / ns * 1e3);
+    }
+
+    // Every recovered frame must be one that was sent intact, byte for byte and in order. The
+    // resync delay is how many bytes past its end the frame behind a damaged one only came out,
+    // since a truncated header makes the scanner wait for the length it announced.
+    for (size_t damage_interval : {size_t{100}, size_t{10}}) {
+        auto stream = synthesize(frame_count, damage_interval, 2);
+        MemorySerial serial;
+        serial.load(stream.bytes, 1);
+        Receiver receiver;
+        std::vector<size_t> delays;
+        size_t index = 0;
+        bool intact  = true;
+        auto begin   = Clock::now();
+        auto frames  = receive(serial, receiver, [&](const Frame& frame, size_t fed) {
+            if (index >= stream.intact_ends.size()) {
+                intact = false;
+                return;
+            }
+            auto end  = stream.intact_ends[index++];
+            auto size = sizeof(frame.header) + sizeof(frame.body.command_id)
+                      + frame.header.data_length + sizeof(uint16_t);
+            intact &= size <= end && fed >= end
+                   && !std::memcmp(&frame, stream.bytes.data() + end - size, size);
+            delays.push_back(fed - std::min(fed, end));
+        });
+        auto ns = elapsed_ns(begin);
+        check(intact && frames == stream.intact_ends.size(), "damaged stream lost intact frames");
+
+        size_t delay_sum = 0, delay_max = 0;
+        for (auto i : stream.after_damage) {
+            if (i < delays.size()) {
+                delay_sum += delays[i];
+                delay_max = std::max(delay_max, delays[i]);
+            }
+        }
+        auto delay_mean = stream.after_damage.empty()
+                            ? 0.0
+                            : static_cast<double>(delay_sum) / stream.after_damage.size();
+        std::printf(
+            "  1 in %3zu damaged, 1-byte reads: %10.0f frames/s %8.1f ns/frame\n"
+            "    resync: %.1f bytes (max %zu) = %.2f ms (max %.2f) of link time\n",
+            damage_interval, frames / ns * 1e9, ns / frames, delay_mean, delay_max,
+            delay_mean / link_rate * 1e3, delay_max / link_rate * 1e3);
+    }
+
+    // Every interaction frame damaged the same way, the cpu side of a resync.
+    for (auto [damage, name] : {
+             std::pair{Damage::FLIPPED_BYTE, "flipped byte"},
+             std::pair{Damage::TRUNCATED, "truncated"},
+             std::pair{Damage::GARBAGE, "garbage"},
+         }) {
+        auto stream   = synthesize(frame_count, 0, 1, damage);
+        size_t frames = 0;
+        auto ns       = time_receive(stream.bytes, 64, frames);
+        check(frames == stream.intact_ends.size(), "damaged stream lost intact frames");
+        std::printf(
+            "  1 in  10 %-12s, 64-byte reads: %10.0f frames/s %8.1f ns/frame\n", name,
+            frames / ns * 1e9, ns / frames);
+    }
+}
+
+void bench_uplink(bool quick) {
+    std::printf("Command and Ui send path\n");
+    auto ticks = quick ? 20'000 : 500'000;
+    auto robot = rmcs_msgs::RobotId{rmcs_msgs::RobotId::RED_HERO};
+
+    // A HUD like app::ui::Infantry, with the status ring changing every tick.
+    app::ui::Shape::Context context;
+    app::ui::Crosshair crosshair{context, app::ui::Shape::Color::WHITE, 960, 540};
+    app::ui::StatusRing status_ring{context};
+    app::ui::Integer power{context, app::ui::Shape::Color::WHITE, 20, 2, 920, 860, 0};
+    app::ui::Text reminder{context, app::ui::Shape::Color::PINK, 50, 5, 1110, 605, "RETURN"};
+    status_ring.set_layers(3, 2);
+
+    command::interaction::ShapePacker packer;
+    command::UplinkFrame frame;
+    MemorySerial serial;
+    size_t frames = 0;
+    auto begin    = Clock::now();
+    for (int tick = 0; tick < ticks; ++tick) {
+        status_ring.update_supercap(20.0 + tick % 7, true);
+        status_ring.update_battery_power(24.0 - tick % 5 * 0.1);
+        status_ring.update_bullet_allowance(static_cast<uint16_t>(400 - tick % 400));
+        power.set_value(tick % 120);
+        reminder.set_visible(tick % 1000 < 500);
+
+        // One 0x0301 frame per tick at most, like the interaction channel of Command.
+        if (!command::interaction::ShapePacker::pending(context))
+            continue;
+        auto data_length = packer.write_updating_field(frame.body.data, context, robot);
+        auto size        = command::seal_frame(frame, 0x0301, data_length);
+        serial.write(reinterpret_cast<const uint8_t*>(&frame), size);
+        ++frames;
+    }
+    auto ns = elapsed_ns(begin);
+    std::printf(
+        "  ui packets: %10.0f frames/s %8.1f ns/frame (shape updates included)\n",
+        frames / ns * 1e9, ns / frames);
+
+    // Everything sent must parse back.
+    auto sent = std::move(serial.written());
+    serial.load(std::move(sent), 4096);
+    Receiver receiver;
+    check(receive(serial, receiver, [](const Frame&, size_t) {}) == frames, "ui frames corrupted");
+
+    // A small field serialized and checksummed on every send, against the same frame prepared.
+    auto header = command::interaction::Header{0x0120, robot, 0x8080};
+    uint32_t decision = 0x12345;
+    auto field        = command::Field{[header, decision](std::byte* buffer) {
+        return command::write_field<0x0301>(buffer, header, decision);
+    }};
+    command::PreparedFrame prepared;
+    prepared.prepare<0x0301>(header, decision);
+
+    MemorySerial sink;
+    begin = Clock::now();
+    for (int i = 0; i < ticks; ++i) {
+        auto size = command::seal_frame(frame, 0x0301, field.write(frame.body.data));
+        sink.write(reinterpret_cast<const uint8_t*>(&frame), size);
+        sink.written().clear();
+    }
+    ns = elapsed_ns(begin);
+    std::printf("  serialized field: %8.1f ns/frame\n", ns / ticks);
+
+    begin = Clock::now();
+    for (int i = 0; i < ticks; ++i) {
+        auto bytes = field.prepared_frame().empty() ? prepared.bytes() : field.prepared_frame();
+        sink.write(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+        sink.written().clear();
+    }
+    ns = elapsed_ns(begin);
+    std::printf("  prepared frame:   %8.1f ns/frame\n", ns / ticks);
+
+    auto size = command::seal_frame(frame, 0x0301, field.write(frame.body.data));
+    check(
+        size == prepared.bytes().size() && !std::memcmp(&frame, prepared.bytes().data(), size),
+        "prepared frame differs from the serialized one");
+}
+
+template <template <typename> class RunQueue>
+struct Entity : app::ui::CfsScheduler<Entity<RunQueue>, RunQueue>::Entity {
+    uint32_t update() { return id; }
+    uint32_t id;
+};
+
+// The scheduler workload of a HUD: every tick `changes` shapes re-enter the run queue, at the
+// delays Shape derives from priority and send count, then a packet takes up to 7 of them while
+// passing over some. Returns ns per run queue operation, `order` gets every update.
+template <template <typename> class RunQueue>
+double time_run_queue(
+    size_t entity_count, size_t changes, int ticks, std::vector<uint32_t>& order) {
+    app::ui::CfsScheduler<Entity<RunQueue>, RunQueue> scheduler;
+    std::vector<std::unique_ptr<Entity<RunQueue>>> entities;
+    for (size_t i = 0; i < entity_count; ++i) {
+        entities.push_back(std::make_unique<Entity<RunQueue>>());
+        entities.back()->id = i;
+    }
+
+    std::minstd_rand random{4};
+    order.clear();
+    size_t operations = 0;
+    auto begin        = Clock::now();
+    for (int tick = 0; tick < ticks; ++tick) {
+        for (size_t i = 0; i < changes; ++i) {
+            auto priority = random() % 256;
+            auto level    = random() % 5;
+            auto delay    = std::min<uint32_t>((256 - priority) << (4 * level), 65535);
+            entities[random() % entity_count]->enter_run_queue(
+                scheduler, static_cast<uint16_t>(65536 - delay));
+        }
+        operations += changes;
+
+        auto iterator = scheduler.get_update_iterator();
+        for (int sent = 0; iterator && sent < 7;) {
+            if (random() % 4 == 0) {
+                iterator.ignore();
+            } else {
+                order.push_back(iterator.update());
+                ++sent;
+            }
+            ++operations;
+        }
+    }
+    return elapsed_ns(begin) / operations;
+}
+
+// Steady: about as many changes per tick as a packet carries. Saturated: a quarter of the shapes
+// change every tick, so nearly all of them wait in the run queue at once.
+void bench_run_queue(bool quick) {
+    std::printf("Shape run queue\n");
+    auto ticks = quick ? 2'000 : 100'000;
+    for (size_t entity_count : {size_t{50}, size_t{200}, size_t{1000}}) {
+        for (auto [changes, load] : {std::pair{size_t{8}, "steady"},
+                                     std::pair{entity_count / 4, "saturated"}}) {
+            std::vector<uint32_t> tree_order, bucket_order;
+            auto tree   = time_run_queue<::RedBlackTree>(entity_count, changes, ticks, tree_order);
+            auto bucket =
+                time_run_queue<app::ui::BucketQueue>(entity_count, changes, ticks, bucket_order);
+            check(tree_order == bucket_order, "run queues disagree on the update order");
+            std::printf(
+                "  %4zu shapes, %-9s: red black tree %6.1f ns/op, bucket queue %6.1f ns/op\n",
+                entity_count, load, tree, bucket);
+        }
+    }
+}
+
+// Ns per call of `append(i)`, which changes a byte of the input and returns a byte of the crc.
+// Those are summed up, so that no call can be skipped.
+template <typename F>
+double time_crc(int calls, F&& append) {
+    uint32_t sum = 0;
+    auto begin   = Clock::now();
+    for (int i = 0; i < calls; ++i)
+        sum += append(static_cast<uint8_t>(i));
+    auto ns  = elapsed_ns(begin);
+    crc_sink = sum;
+    return ns / calls;
+}
+
+// utility::crc must produce exactly what serial_util::dji_crc did, which it replaced.
+void bench_crc(bool quick) {
+    std::printf("Crc\n");
+    std::minstd_rand random{5};
+    std::vector<uint8_t> ours(sizeof(Frame) + 2), theirs(sizeof(Frame) + 2);
+
+    bool same = true;
+    for (int i = 0; i < 1000; ++i) {
+        FrameHeader header;
+        auto bytes = reinterpret_cast<uint8_t*>(&header);
+        for (size_t j = 0; j < sizeof(header); ++j)
+            bytes[j] = random();
+        auto expected = header;
+        utility::crc::append_crc8(header);
+        serial_util::dji_crc::append_crc8(expected);
+        same &= !std::memcmp(&header, &expected, sizeof(header));
+        same &= utility::crc::verify_crc8(expected) && serial_util::dji_crc::verify_crc8(header);
+
+        auto size = 3 + random() % (ours.size() - 2);
+        for (size_t j = 0; j < size; ++j)
+            ours[j] = theirs[j] = random();
+        utility::crc::append_crc16(ours.data(), size);
+        serial_util::dji_crc::append_crc16(theirs.data(), size);
+        same &= ours == theirs;
+        same &= utility::crc::verify_crc16(theirs.data(), size)
+             && serial_util::dji_crc::verify_crc16(ours.data(), size);
+    }
+    check(same, "utility::crc differs from serial_util::dji_crc");
+
+    auto calls = quick ? 2'000 : 200'000;
+    FrameHeader header{sof_value, 15, 0, 0};
+    std::printf(
+        "  crc8 of a header:  utility %6.1f ns, dji_crc %6.1f ns\n",
+        time_crc(calls * 10, [&](uint8_t i) {
+            header.sof = i;
+            utility::crc::append_crc8(header);
+            return header.crc8;
+        }),
+        time_crc(calls * 10, [&](uint8_t i) {
+            header.sof = i;
+            serial_util::dji_crc::append_crc8(header);
+            return header.crc8;
+        }));
+
+    // A 1-shape ui packet, a 7-shape one and the largest frame.
+    for (size_t size : {size_t{30}, size_t{120}, sizeof(Frame)}) {
+        auto data = ours.data();
+        std::printf(
+            "  crc16 of %4zu bytes: utility %6.1f ns, dji_crc %6.1f ns\n", size,
+            time_crc(calls, [&](uint8_t i) {
+                data[0] = i;
+                utility::crc::append_crc16(data, size);
+                return data[size - 1];
+            }),
+            time_crc(calls, [&](uint8_t i) {
+                data[0] = i;
+                serial_util::dji_crc::append_crc16(data, size);
+                return data[size - 1];
+            }));
+    }
+}
+
+} // namespace
+} // namespace rmcs_referee::bench
+
+int main(int argc, char** argv) {
+    using namespace rmcs_referee::bench;
+    bool quick = argc > 1 && std::string_view{argv[1]} == "--quick";
+
+    bench_parser(quick);
+    bench_uplink(quick);
+    bench_run_queue(quick);
+    bench_crc(quick);
+
+    return failed ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <span>
+#include <thread>
+
+#include "utility/spsc_queue.hpp"
+
+// Checks where SpscByteQueue places its two segments, and that bytes written through
+// writable_spans() come out of readable_spans() intact while the other side keeps moving its
+// index, the way the io thread and the executor share the queues of Transport.
+// Exits with 1 on the first failure.
+
+namespace rmcs_referee::bench {
+namespace {
+
+// Runs `step` after every load, standing in for the other thread moving its index between two
+// loads of the same call.
+template <typename T>
+class SteppingAtomic {
+public:
+    SteppingAtomic(T value)
+        : value_(value) {}
+
+    T load(std::memory_order order) const {
+        auto value = value_.load(order);
+        if (step && !stepping) {
+            stepping = true;
+            step();
+            stepping = false;
+        }
+        return value;
+    }
+    void store(T value, std::memory_order order) { value_.store(value, order); }
+
+    static inline std::function<void()> step;
+    static inline bool stepping = false;
+
+private:
+    std::atomic<T> value_;
+};
+
+constexpr size_t capacity = 16;
+using Queue               = utility::SpscByteQueue<capacity>;
+using SteppingQueue       = utility::SpscByteQueue<capacity, SteppingAtomic>;
+
+bool failed = false;
+
+void check(bool condition, const char* what) {
+    if (!condition && !failed) {
+        std::printf("FAILED: %s\n", what);
+        failed = true;
+    }
+}
+
+// Segments must start at the index of their side and hold between `min_size` and `max_size`
+// bytes, the other side moving in between. The second segment is only used, from the start of
+// the buffer, once the first one reaches the end.
+template <typename Span>
+void check_spans(
+    const std::array<Span, 2>& spans, const std::byte* buffer, size_t index, size_t min_size,
+    size_t max_size) {
+    auto [first, second] = spans;
+    auto size            = first.size() + second.size();
+    check(first.data() == buffer + index % capacity, "first segment misplaced");
+    check(size >= min_size && size <= max_size, "segments do not add up");
+    check(
+        second.empty() || first.data() + first.size() == buffer + capacity,
+        "second segment used before the first one reaches the end");
+    check(second.empty() || second.data() == buffer, "second segment misplaced");
+}
+
+// Every position of both indices, each call seeing the other index move by one on every load.
+void test_placement() {
+    for (size_t start = 0; start < capacity; ++start) {
+        for (size_t filled = 0; filled <= capacity; ++filled) {
+            SteppingQueue queue;
+            auto buffer = queue.writable_spans()[0].data();
+            queue.commit(start);
+            queue.consume(start);
+            queue.commit(filled);
+
+            // The consumer frees a byte whenever the producer loads an index.
+            SteppingAtomic<size_t>::step = [&] {
+                if (queue.readable())
+                    queue.consume(1);
+            };
+            auto free   = capacity - filled;
+            auto spans  = queue.writable_spans();
+            auto actual = queue.writable();
+            SteppingAtomic<size_t>::step = nullptr;
+            check_spans(spans, buffer, start + filled, free, actual);
+
+            // The producer adds a byte whenever the consumer loads an index.
+            auto size = queue.readable();
+            SteppingAtomic<size_t>::step = [&] {
+                if (queue.writable())
+                    queue.commit(1);
+            };
+            auto readable = queue.readable_spans();
+            auto after    = queue.readable();
+            SteppingAtomic<size_t>::step = nullptr;
+            check_spans(readable, buffer, start + filled - size, size, after);
+        }
+    }
+}
+
+// A producer and a consumer thread stream a counter through the queue in segments.
+void test_concurrent() {
+    constexpr size_t total = 4'000'000;
+    Queue queue;
+    std::atomic<bool> corrupted = false;
+
+    std::thread producer{[&] {
+        size_t written = 0;
+        while (written < total) {
+            auto [first, second] = queue.writable_spans();
+            size_t size          = 0;
+            for (auto span : {first, second})
+                for (auto& byte : span)
+                    if (written + size < total)
+                        byte = static_cast<std::byte>(written + size++);
+            queue.commit(size);
+            written += size;
+            if (!size)
+                std::this_thread::yield();
+        }
+    }};
+
+    size_t read = 0;
+    while (read < total) {
+        auto [first, second] = queue.readable_spans();
+        size_t size          = 0;
+        for (auto span : {first, second})
+            for (auto byte : span)
+                if (byte != static_cast<std::byte>(read + size++))
+                    corrupted = true;
+        queue.consume(size);
+        read += size;
+        if (!size)
+            std::this_thread::yield();
+    }
+    producer.join();
+    check(!corrupted, "bytes corrupted between the threads");
+}
+
+} // namespace
+} // namespace rmcs_referee::bench
+
+int main() {
+    using namespace rmcs_referee::bench;
+    test_placement();
+    test_concurrent();
+    if (!failed)
+        std::printf("spsc_queue_test passed\n");
+    return failed ? 1 : 0;
+}
\ No newline at end of file
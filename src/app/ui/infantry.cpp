@@ -1,6 +1,8 @@
 #include <algorithm>
 #include <cmath>
 #include <cstdint>
+#include <initializer_list>
+#include <string>
 
 #include <game_stage.hpp>
 #include <rclcpp/node.hpp>
@@ -22,26 +24,46 @@ class Infantry
 public:
     Infantry()
         : Node{get_component_name(), rclcpp::NodeOptions{}.automatically_declare_parameters_from_overrides(true)}
-        , crosshair_(Shape::Color::WHITE, x_center - 12, y_center - 37)
-        , status_ring_()
+        , crosshair_(context_, Shape::Color::WHITE, x_center - 12, y_center - 37)
+        , status_ring_(context_)
         , horizontal_center_guidelines_(
-              {Shape::Color::WHITE, 2, x_center - 360, y_center, x_center - 110, y_center},
-              {Shape::Color::WHITE, 2, x_center + 110, y_center, x_center + 360, y_center})
+              {context_, Shape::Color::WHITE, 2, x_center - 360, y_center, x_center - 110, y_center},
+              {context_, Shape::Color::WHITE, 2, x_center + 110, y_center, x_center + 360, y_center})
         , vertical_center_guidelines_(
-              {Shape::Color::WHITE, 2, x_center, 800, x_center, y_center + 110},
-              {Shape::Color::WHITE, 2, x_center, y_center - 110, x_center, 200})
-        , chassis_power_number_(Shape::Color::WHITE, 20, 2, x_center - 40, 860, 0)
+              {context_, Shape::Color::WHITE, 2, x_center, 800, x_center, y_center + 110},
+              {context_, Shape::Color::WHITE, 2, x_center, y_center - 110, x_center, 200})
+        , chassis_power_number_(context_, Shape::Color::WHITE, 20, 2, x_center - 40, 860, 0)
         , yaw_indicator_guidelines_(
-              {Shape::Color::WHITE, 2, x_center - 32, 830, x_center + 32, 830},
-              {Shape::Color::WHITE, 2, x_center, 830, x_center, 820})
-        , chassis_direction_indicator_(Shape::Color::PINK, 8, x_center, y_center, 0, 0, 84, 84)
-        , chassis_control_power_limit_indicator_(Shape::Color::WHITE, 20, 2, x_center + 10, 820, 0)
-        , supercap_control_power_limit_indicator_(Shape::Color::WHITE, 20, 2, x_center + 10, 790, 0)
-        , time_reminder_(Shape::Color::PINK, 50, 5, x_center + 150, y_center + 65, 0, false) {
+              {context_, Shape::Color::WHITE, 2, x_center - 32, 830, x_center + 32, 830},
+              {context_, Shape::Color::WHITE, 2, x_center, 830, x_center, 820})
+        , chassis_direction_indicator_(context_, Shape::Color::PINK, 8, x_center, y_center, 0, 0, 84, 84)
+        , chassis_control_direction_indicator_(context_)
+        , chassis_control_power_limit_indicator_(context_, Shape::Color::WHITE, 20, 2, x_center + 10, 820, 0)
+        , supercap_control_power_limit_indicator_(context_, Shape::Color::WHITE, 20, 2, x_center + 10, 790, 0)
+        , time_reminder_(context_, Shape::Color::PINK, 50, 5, x_center + 150, y_center + 65, 0, false) {
 
         chassis_control_direction_indicator_.set_x(x_center);
         chassis_control_direction_indicator_.set_y(y_center);
 
+        // Layer 1: aiming aids, 2: status ring frame, 3: status ring bars, 4: chassis indicators.
+        crosshair_.set_layer(1);
+        for (auto& line : horizontal_center_guidelines_)
+            line.set_layer(1);
+        for (auto& line : vertical_center_guidelines_)
+            line.set_layer(1);
+        status_ring_.set_layers(3, 2);
+        for (Shape* shape : std::initializer_list<Shape*>{
+                 &chassis_power_number_, &yaw_indicator_guidelines_[0],
+                 &yaw_indicator_guidelines_[1], &chassis_direction_indicator_,
+                 &chassis_control_direction_indicator_, &chassis_control_power_limit_indicator_,
+                 &supercap_control_power_limit_indicator_, &time_reminder_})
+            shape->set_layer(4);
+
+        // The shapes are sent by command::interaction::Ui, which reads them from this context.
+        register_output(
+            get_parameter_or<std::string>("context", "/referee/ui/context"), context_output_,
+            &context_);
+
         register_input("/chassis/control_mode", chassis_mode_);
 
         register_input("/chassis/angle", chassis_angle_);
@@ -155,6 +177,10 @@ private:
 
     // InputInterface<std::pair<uint16_t, uint16_t>> auto_aim_target_;
 
+    // Declared before the shapes, which are removed from it when destroyed.
+    Shape::Context context_;
+    OutputInterface<Shape::Context*> context_output_;
+
     Crosshair crosshair_;
     StatusRing status_ring_;
 
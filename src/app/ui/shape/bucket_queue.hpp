@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <bit>
+#include <type_traits>
+
+namespace rmcs_referee::app::ui {
+
+// Queue ordered by an integer key, usable by CfsScheduler in place of RedBlackTree.
+// Keys are spread over a ring of buckets, each a sorted list covering `1 << width_bits` keys,
+// and a bitmap finds the first non-empty bucket. As long as buckets hold few entries, which is
+// the case for vruntimes spread by the scheduler, inserting and erasing are O(1) with no pointer
+// chasing down a tree. Keys behind the window go to its first bucket, keys past it to a sorted
+// overflow list, merged in as the window moves forward.
+// T must derive from Node and provide `uint64_t key() const`; equal keys keep insertion order.
+template <typename T, size_t bucket_count = 1024, unsigned width_bits = 8>
+class BucketQueue final {
+    static_assert(bucket_count % 64 == 0 && std::has_single_bit(bucket_count));
+
+public:
+    class Node {
+    public:
+        friend class BucketQueue;
+
+        bool is_dangling() const { return !linked_; }
+
+    private:
+        Node *prev_ = nullptr, *next_ = nullptr;
+        uint16_t bucket_ = 0;
+        bool linked_     = false;
+    };
+
+    BucketQueue()                              = default;
+    BucketQueue(const BucketQueue&)            = delete;
+    BucketQueue& operator=(const BucketQueue&) = delete;
+
+    bool insert(T& node) requires(std::is_base_of_v<Node, T>) {
+        if (!static_cast<Node&>(node).is_dangling())
+            return false;
+
+        auto key = node.key();
+        if (!size_) {
+            base_ = key >> width_bits << width_bits;
+            head_ = 0;
+        } else if (key >= window_end()) {
+            advance();
+        }
+
+        link(node, bucket_of(key));
+        ++size_;
+        return true;
+    }
+
+    bool erase(T& node) requires(std::is_base_of_v<Node, T>) {
+        if (static_cast<Node&>(node).is_dangling())
+            return false;
+
+        unlink(node);
+        --size_;
+        return true;
+    }
+
+    bool empty() const { return !size_; }
+
+    T* first() const requires(std::is_base_of_v<Node, T>) {
+        return head_of(next_bucket(0));
+    }
+
+    T* next(T& node) const requires(std::is_base_of_v<Node, T>) {
+        auto& current = static_cast<Node&>(node);
+        if (current.next_)
+            return entry(current.next_);
+        if (current.bucket_ == overflow)
+            return nullptr;
+
+        return head_of(next_bucket(((current.bucket_ - head_) & mask) + 1));
+    }
+
+private:
+    static constexpr size_t mask     = bucket_count - 1;
+    static constexpr size_t overflow = bucket_count;
+
+    struct List {
+        Node *head = nullptr, *tail = nullptr;
+    };
+
+    static T* entry(Node* node) { return static_cast<T*>(node); }
+
+    // First entry of the bucket, or of the overflow when the bucket is past the window.
+    T* head_of(size_t logical) const {
+        auto& list = logical < bucket_count ? lists_[physical(logical)] : lists_[overflow];
+        return entry(list.head);
+    }
+
+    uint64_t window_end() const { return base_ + (uint64_t{bucket_count} << width_bits); }
+
+    size_t physical(size_t logical) const { return (head_ + logical) & mask; }
+
+    size_t bucket_of(uint64_t key) const {
+        if (key < base_)
+            return physical(0);
+        auto logical = (key - base_) >> width_bits;
+        return logical < bucket_count ? physical(logical) : overflow;
+    }
+
+    // First non-empty bucket at or after `logical`, counted from the start of the window.
+    // Returns bucket_count if there is none.
+    size_t next_bucket(size_t logical) const {
+        while (logical < bucket_count) {
+            auto index = physical(logical);
+            if (auto bits = occupied_[index / 64] >> (index % 64)) {
+                logical += std::countr_zero(bits);
+                return logical < bucket_count ? logical : bucket_count;
+            }
+            logical += 64 - index % 64;
+        }
+        return bucket_count;
+    }
+
+    // Moves the window past its leading empty buckets, then merges in the overflow entries now
+    // inside it. Those buckets were empty, so the sorted overflow is simply appended in order.
+    void advance() {
+        uint64_t shift = next_bucket(0);
+        if (shift == bucket_count) {
+            auto overflow_first = lists_[overflow].head;
+            if (!overflow_first)
+                return;
+            shift = (entry(overflow_first)->key() - base_) >> width_bits;
+        }
+        if (!shift)
+            return;
+
+        head_ = (head_ + shift) & mask;
+        base_ += shift << width_bits;
+
+        while (auto node = entry(lists_[overflow].head)) {
+            auto key = node->key();
+            if (key >= window_end())
+                break;
+            unlink(*node);
+            link(*node, bucket_of(key));
+        }
+    }
+
+    void link(T& node, size_t bucket) {
+        auto& list = lists_[bucket];
+        auto key   = node.key();
+
+        // Updated entities go behind the ones already queued, while entities clamped to the
+        // minimum vruntime go in front, so the walk starts from the closer end.
+        Node* after = list.tail;
+        if (after && entry(after)->key() > key) {
+            auto head_key = entry(list.head)->key(), tail_key = entry(after)->key();
+            if (key < head_key || key - head_key < tail_key - key) {
+                after = nullptr;
+                for (auto next = list.head; entry(next)->key() <= key; next = next->next_)
+                    after = next;
+            } else {
+                while (after && entry(after)->key() > key)
+                    after = after->prev_;
+            }
+        }
+
+        auto& current   = static_cast<Node&>(node);
+        current.prev_   = after;
+        current.next_   = after ? after->next_ : list.head;
+        current.bucket_ = static_cast<uint16_t>(bucket);
+        current.linked_ = true;
+        (current.next_ ? current.next_->prev_ : list.tail) = &current;
+        (after ? after->next_ : list.head)                 = &current;
+
+        if (bucket != overflow)
+            occupied_[bucket / 64] |= uint64_t{1} << (bucket % 64);
+    }
+
+    void unlink(T& node) {
+        auto& current = static_cast<Node&>(node);
+        auto& list    = lists_[current.bucket_];
+        (current.prev_ ? current.prev_->next_ : list.head) = current.next_;
+        (current.next_ ? current.next_->prev_ : list.tail) = current.prev_;
+
+        if (!list.head && current.bucket_ != overflow)
+            occupied_[current.bucket_ / 64] &= ~(uint64_t{1} << (current.bucket_ % 64));
+
+        current.prev_ = current.next_ = nullptr;
+        current.linked_               = false;
+    }
+
+    std::array<List, bucket_count + 1> lists_{};
+    std::array<uint64_t, bucket_count / 64> occupied_{};
+
+    uint64_t base_ = 0;
+    size_t head_   = 0;
+    size_t size_   = 0;
+};
+
+} // namespace rmcs_referee::app::ui
\ No newline at end of file
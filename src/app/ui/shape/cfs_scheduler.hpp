@@ -4,49 +4,56 @@
 
 #include <type_traits>
 
+#include "bucket_queue.hpp"
 #include "red_black_tree.hpp"
 
 namespace rmcs_referee::app::ui {
 
-template <typename T>
+// One run queue of entities. Each UI client owns its own scheduler, and entities are always
+// given the scheduler they belong to.
+// The run queue is ordered by vruntime, either by a RedBlackTree or by a BucketQueue which keeps
+// enqueueing O(1) for entities re-entering the queue several times per tick.
+template <typename T, template <typename> class RunQueue = RedBlackTree>
 class CfsScheduler {
 public:
     class __attribute__((packed, aligned(sizeof(void*)))) Entity
-        : private RedBlackTree<Entity>::Node {
+        : private RunQueue<Entity>::Node {
     public:
         friend class CfsScheduler;
-        friend class RedBlackTree<Entity>;
+        friend RunQueue<Entity>;
 
         bool is_in_run_queue() requires(std::is_base_of_v<Entity, T>) {
-            return !RedBlackTree<Entity>::Node::is_dangling();
+            return !RunQueue<Entity>::Node::is_dangling();
         }
 
-        void enter_run_queue(uint16_t priority) requires(std::is_base_of_v<Entity, T>) {
+        void enter_run_queue(CfsScheduler& scheduler, uint16_t priority)
+            requires(std::is_base_of_v<Entity, T>) {
             if (this->priority_ != priority) {
                 vruntime_ += this->priority_;
                 vruntime_ -= priority;
-                if (this->vruntime_ < min_vruntime_)
-                    this->vruntime_ = min_vruntime_;
+                if (this->vruntime_ < scheduler.min_vruntime_)
+                    this->vruntime_ = scheduler.min_vruntime_;
 
                 this->priority_ = priority;
 
                 if (is_in_run_queue())
-                    run_queue_.erase(*this);
+                    scheduler.run_queue_.erase(*this);
             } else {
                 if (is_in_run_queue())
                     return;
             }
 
-            run_queue_.insert(*this);
+            scheduler.run_queue_.insert(*this);
         }
 
-        void leave_run_queue() requires(std::is_base_of_v<Entity, T>) {
+        void leave_run_queue(CfsScheduler& scheduler) requires(std::is_base_of_v<Entity, T>) {
             if (is_in_run_queue()) [[likely]]
-                run_queue_.erase(*this);
+                scheduler.run_queue_.erase(*this);
         }
 
     private:
         bool operator<(const Entity& obj) const { return vruntime_ < obj.vruntime_; }
+        uint64_t key() const { return vruntime_; }
         uint64_t vruntime_ : 48 = 65536;
         uint16_t priority_      = 0;
     };
@@ -55,8 +62,9 @@ public:
 
     class UpdateIterator {
     public:
-        UpdateIterator()
-            : current_(run_queue_.first())
+        explicit UpdateIterator(CfsScheduler& scheduler)
+            : scheduler_(&scheduler)
+            , current_(scheduler.run_queue_.first())
             , ignored_(nullptr) {}
         UpdateIterator(const UpdateIterator&)            = delete;
         UpdateIterator& operator=(const UpdateIterator&) = delete;
@@ -73,36 +81,42 @@ public:
         explicit operator bool() const { return get(); }
 
         auto update() {
-            min_vruntime_ = current_->vruntime_;
-            int shift     = 65536 - current_->priority_;
+            scheduler_->min_vruntime_ = current_->vruntime_;
+            int shift                 = 65536 - current_->priority_;
             current_->vruntime_ += shift;
 
-            run_queue_.erase(*current_);
+            auto& run_queue = scheduler_->run_queue_;
+            run_queue.erase(*current_);
             auto result = get()->update();
-            current_    = ignored_ ? ignored_->next() : run_queue_.first();
+            current_    = ignored_ ? run_queue.next(*ignored_) : run_queue.first();
 
             return result;
         }
 
         void ignore() {
             ignored_ = current_;
-            current_ = ignored_->next();
+            current_ = scheduler_->run_queue_.next(*ignored_);
         }
 
     private:
+        CfsScheduler* scheduler_;
         Entity *current_, *ignored_;
     };
 
-    static inline bool empty() { return run_queue_.empty(); }
+    CfsScheduler()                               = default;
+    CfsScheduler(const CfsScheduler&)            = delete;
+    CfsScheduler& operator=(const CfsScheduler&) = delete;
 
-    static inline UpdateIterator get_update_iterator()
+    bool empty() const { return run_queue_.empty(); }
+
+    UpdateIterator get_update_iterator()
         requires std::is_base_of_v<Entity, T> && requires(T t) { t.update(); } {
-        return UpdateIterator{};
+        return UpdateIterator{*this};
     }
 
 private:
-    static inline RedBlackTree<Entity> run_queue_;
-    static inline uint64_t min_vruntime_ = 0;
+    RunQueue<Entity> run_queue_;
+    uint64_t min_vruntime_ = 0;
 };
 
 } // namespace rmcs_referee::app::ui
\ No newline at end of file
@@ -676,6 +676,9 @@ public:
     T* last() const requires(std::is_base_of_v<Node, T>) {
         return static_cast<T*>(static_cast<Node*>(tree_.last()));
     }
+    T* next(T& node) const requires(std::is_base_of_v<Node, T>) {
+        return static_cast<Node&>(node).next();
+    }
 
 private:
     BasicRedBlackTree tree_;
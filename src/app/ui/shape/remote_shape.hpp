@@ -2,9 +2,14 @@
 
 #include <cstdint>
 
+#include <utility>
+
 #include "red_black_tree.hpp"
 
 namespace rmcs_referee::app::ui {
+
+// Graphic ids of one referee client. Each UI client owns its own allocator, and descriptors are
+// always given the allocator they take their id from.
 template <typename T>
 class RemoteShape {
 public:
@@ -20,77 +25,95 @@ public:
         Descriptor& operator=(Descriptor&& obj)  = delete;
 
         [[nodiscard]] bool has_id() const { return id_; }
-        [[nodiscard]] bool try_assign_id()
+        [[nodiscard]] bool try_assign_id(RemoteShape& remote)
             requires std::is_base_of_v<Descriptor, T> && requires(T t) { t.id_revoked(); } {
             if (has_id()) [[unlikely]]
                 return false;
 
-            if (Descriptor* first = swapping_queue_.first()) {
+            if (Descriptor* first = remote.swapping_queue_.first()) {
                 // Optimization: Try to find a descriptor to avoid creating a new one.
-                swapping_queue_.erase(*first);
-                swap_id(*first);
+                remote.swapping_queue_.erase(*first);
+                swap_id(remote, *first);
+                return true;
+            }
+
+            if (remote.free_id_count_) {
+                assign_id(remote, remote.free_ids_[--remote.free_id_count_]);
                 return true;
             }
 
-            if (next_id_ > id_assignment_max) [[unlikely]]
+            if (remote.next_id_ > id_assignment_max) [[unlikely]]
                 return false;
             else {
-                assign_id();
+                assign_id(remote, remote.next_id_++);
                 return true;
             }
         }
-        [[nodiscard]] bool predict_try_assign_id(uint8_t& existence_confidence) const {
+        [[nodiscard]] bool
+            predict_try_assign_id(const RemoteShape& remote, uint8_t& existence_confidence) const {
             if (has_id()) [[unlikely]]
                 return false;
 
-            if (Descriptor* first = swapping_queue_.first()) {
+            if (Descriptor* first = remote.swapping_queue_.first()) {
                 existence_confidence = first->existence_confidence_;
                 return true;
             }
 
-            return next_id_ <= id_assignment_max;
+            return remote.free_id_count_ || remote.next_id_ <= id_assignment_max;
+        }
+
+        // Gives the id back without notifying the shape, for when the remote shape is known to be
+        // gone already, e.g. its layer was deleted.
+        void release_id(RemoteShape& remote) {
+            if (!has_id())
+                return;
+            disable_swapping(remote);
+            remote.assigned_list_[id_ - 1]            = nullptr;
+            remote.free_ids_[remote.free_id_count_++] = id_;
+            id_                                       = 0;
+            existence_confidence_                     = 0;
         }
 
         [[nodiscard]] bool swapping_enabled() const {
             return !RedBlackTree<Descriptor>::Node::is_dangling();
         }
-        void enable_swapping() {
+        void enable_swapping(RemoteShape& remote) {
             if (swapping_enabled())
                 return;
-            swapping_queue_.insert(*this);
+            remote.swapping_queue_.insert(*this);
         }
-        void disable_swapping() {
+        void disable_swapping(RemoteShape& remote) {
             if (!swapping_enabled())
                 return;
-            swapping_queue_.erase(*this);
+            remote.swapping_queue_.erase(*this);
         }
 
         [[nodiscard]] uint8_t id() const { return id_; }
         [[nodiscard]] uint8_t existence_confidence() const { return existence_confidence_; }
 
-        uint8_t increase_existence_confidence() {
+        uint8_t increase_existence_confidence(RemoteShape& remote) {
             ++existence_confidence_;
             if (swapping_enabled()) {
-                disable_swapping(), enable_swapping();
+                disable_swapping(remote), enable_swapping(remote);
             }
             return existence_confidence_;
         }
 
     private:
         /* Swap requirement: !this->id_ && victim.id_ */
-        void swap_id(Descriptor& victim) {
-            id_                     = victim.id_;
-            assigned_list_[id_ - 1] = this;
-            existence_confidence_   = victim.existence_confidence_;
+        void swap_id(RemoteShape& remote, Descriptor& victim) {
+            id_                            = victim.id_;
+            remote.assigned_list_[id_ - 1] = this;
+            existence_confidence_          = victim.existence_confidence_;
 
             victim.revoke_id();
         }
 
-        /* Assign requirement: next_id_ <= id_assignment_max */
-        void assign_id() {
-            id_ = next_id_++;
+        /* Assign requirement: id is neither assigned nor free */
+        void assign_id(RemoteShape& remote, uint8_t id) {
+            id_ = id;
 
-            assigned_list_[id_ - 1] = this;
+            remote.assigned_list_[id_ - 1] = this;
         }
 
         void revoke_id() {
@@ -108,19 +131,30 @@ public:
         uint8_t existence_confidence_ = 0;
     };
 
-    static inline void force_revoke_all_id() {
+    RemoteShape()                              = default;
+    RemoteShape(const RemoteShape&)            = delete;
+    RemoteShape& operator=(const RemoteShape&) = delete;
+
+    void force_revoke_all_id() {
         for (int i = 0; i < next_id_ - 1; ++i) {
-            assigned_list_[i]->revoke_id();
+            if (auto descriptor = std::exchange(assigned_list_[i], nullptr)) {
+                descriptor->disable_swapping(*this);
+                descriptor->revoke_id();
+            }
         }
-        next_id_ = 1;
+        next_id_       = 1;
+        free_id_count_ = 0;
     }
 
 private:
     static constexpr uint8_t id_assignment_max = 201;
 
-    static inline uint8_t next_id_ = 1;
-    static inline Descriptor* assigned_list_[id_assignment_max];
+    uint8_t next_id_ = 1;
+    Descriptor* assigned_list_[id_assignment_max]{};
+
+    uint8_t free_id_count_ = 0;
+    uint8_t free_ids_[id_assignment_max];
 
-    static inline RedBlackTree<Descriptor> swapping_queue_;
+    RedBlackTree<Descriptor> swapping_queue_;
 };
 } // namespace rmcs_referee::app::ui
\ No newline at end of file
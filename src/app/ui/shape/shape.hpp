@@ -4,7 +4,9 @@
 #include "command/field.hpp"
 #include "remote_shape.hpp"
 
+#include <algorithm>
 #include <bit>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <new>
@@ -13,17 +15,144 @@ namespace rmcs_referee {
 
 namespace command::interaction {
 class Ui;
+class ShapePacker;
 }
 
 namespace app::ui {
 
 class Shape
-    : private CfsScheduler<Shape>::Entity
+    : private CfsScheduler<Shape, BucketQueue>::Entity
     , private RemoteShape<Shape>::Descriptor {
 public:
-    friend class CfsScheduler<Shape>;
+    friend class CfsScheduler<Shape, BucketQueue>;
     friend class RemoteShape<Shape>;
     friend class command::interaction::Ui;
+    friend class command::interaction::ShapePacker;
+
+    static constexpr uint8_t layer_count = 10;
+
+    // The shapes of one UI client: their run queue, graphic ids and layers. Each client, e.g. a
+    // driver HUD and a debugging HUD, has its own context; shapes are given theirs on
+    // construction and must not outlive it.
+    class Context {
+    public:
+        Context()                          = default;
+        Context(const Context&)            = delete;
+        Context& operator=(const Context&) = delete;
+
+        bool layer_visible(uint8_t layer) const { return !(hidden_layers_ & (1u << layer)); }
+
+        // Hiding deletes the whole layer remotely with a single 0x0100 command instead of hiding
+        // its shapes one by one. Showing draws its visible shapes again.
+        void set_layer_visible(uint8_t layer, bool visible) {
+            if (layer_visible(layer) == visible)
+                return;
+
+            if (!visible) {
+                hidden_layers_ |= 1u << layer;
+                for (auto shape = layer_heads_[layer]; shape; shape = shape->layer_next_)
+                    shape->leave_run_queue(), shape->release_id();
+                request_layer_clear(layer);
+            } else {
+                hidden_layers_ &= ~(1u << layer);
+                for (auto shape = layer_heads_[layer]; shape; shape = shape->layer_next_)
+                    shape->redraw();
+            }
+        }
+
+        // Deletes the layers remotely and draws their visible shapes again, leaving other layers
+        // as they are.
+        void reset_layers(uint16_t mask) {
+            for (uint8_t layer = 0; layer < layer_count; ++layer) {
+                if (!(mask & (1u << layer)) || !layer_visible(layer))
+                    continue;
+                for (auto shape = layer_heads_[layer]; shape; shape = shape->layer_next_) {
+                    shape->release_id();
+                    shape->redraw();
+                }
+                request_layer_clear(layer);
+            }
+        }
+
+        // Layers holding shapes that may exist remotely.
+        uint16_t used_layers() const {
+            uint16_t mask = 0;
+            for (uint8_t layer = 0; layer < layer_count; ++layer) {
+                for (auto shape = layer_heads_[layer]; shape; shape = shape->layer_next_) {
+                    if (shape->has_id()) {
+                        mask |= 1u << layer;
+                        break;
+                    }
+                }
+            }
+            return mask;
+        }
+
+        // Nothing is acknowledged by the referee, so every change is sent again until it is
+        // assumed to have arrived. The number of sends follows the loss rate of the link: a change
+        // arrives with 99% probability, so a clean link does not spend its bandwidth on blind
+        // repeats.
+        uint8_t update_times() const { return update_times_; }
+        void set_loss_rate(double loss_rate) {
+            loss_rate  = std::clamp(loss_rate, 0.0, max_loss_rate);
+            auto times = 1.0;
+            if (loss_rate > 0.0)
+                times = std::ceil(std::log(1.0 - target_delivery) / std::log(loss_rate));
+            update_times_ = static_cast<uint8_t>(std::clamp(times, 1.0, double(max_update_times)));
+        }
+
+    private:
+        friend class Shape;
+        friend class command::interaction::Ui;
+        friend class command::interaction::ShapePacker;
+
+        void request_layer_clear(uint8_t layer) { layer_clear_times_[layer] = update_times_; }
+
+        // Next layer whose deletion still has to be sent, -1 if there is none. Like shape updates,
+        // each deletion is sent several times since nothing is acknowledged.
+        int take_layer_clear() {
+            for (uint8_t layer = 0; layer < layer_count; ++layer) {
+                if (layer_clear_times_[layer]) {
+                    --layer_clear_times_[layer];
+                    return layer;
+                }
+            }
+            return -1;
+        }
+        bool has_layer_clear() const {
+            for (auto times : layer_clear_times_)
+                if (times)
+                    return true;
+            return false;
+        }
+        void cancel_layer_clears() {
+            for (auto& times : layer_clear_times_)
+                times = 0;
+        }
+
+        // Setters make shapes re-enter the run queue all the time, which a bucket queue does in
+        // constant time.
+        CfsScheduler<Shape, BucketQueue> scheduler_;
+        RemoteShape<Shape> remote_shape_;
+
+        Shape* layer_heads_[layer_count]{};
+        uint16_t hidden_layers_ = 0;
+        uint8_t layer_clear_times_[layer_count]{};
+
+        uint8_t update_times_ = default_update_times;
+    };
+
+    explicit Shape(Context& context)
+        : context_(context) {
+        link_layer();
+    }
+    virtual ~Shape() {
+        unlink_layer();
+        leave_run_queue();
+        release_id();
+    }
+
+    Context& context() const { return context_; }
 
     bool visible() const { return visible_; }
     void set_visible(bool value) {
@@ -32,6 +161,10 @@ public:
 
         visible_ = value;
 
+        // Drawn again when the layer is shown.
+        if (!context_.layer_visible(layer_))
+            return;
+
         // Optimizations
         if (!visible_) {
             if (existence_confidence() == 0) {
@@ -51,6 +184,29 @@ public:
         enter_run_queue();
     }
 
+    // Layers group shapes so they can be hidden, shown or redrawn together. The layer is meant to
+    // be set before the shape is first sent: a remote shape cannot be moved, so its old layer is
+    // deleted and the shapes left there are drawn again.
+    uint8_t layer() const { return layer_; }
+    void set_layer(uint8_t layer) {
+        if (layer_ == layer || layer >= layer_count)
+            return;
+
+        auto old_layer = layer_;
+        unlink_layer();
+        layer_ = layer;
+        link_layer();
+
+        if (has_id()) {
+            release_id();
+            context_.reset_layers(1u << old_layer);
+        }
+        if (shown())
+            redraw();
+        else
+            leave_run_queue();
+    }
+
     uint8_t priority() const { return priority_; }
     void set_priority(uint8_t value) {
         if (priority_ == value)
@@ -102,13 +258,12 @@ public:
         }
 
         if (predict_existence == 0) {
-            predict_sync = max_update_times;
+            predict_sync = context_.update_times_;
         }
 
-        command::Field field;
-        if (visible_
+        if (shown()
             && (predict_existence <= predict_sync
-                || (last_time_modified_ && predict_existence < max_update_times))) {
+                || (last_time_modified_ && predict_existence < context_.update_times_))) {
             return Operation::ADD;
         } else {
             return Operation::MODIFY;
@@ -171,7 +326,7 @@ protected:
 
     void set_modified() {
         // Optimization: Assume the modification not exist when invisible.
-        if (!visible_)
+        if (!shown())
             return;
 
         sync_confidence_ = 0;
@@ -184,16 +339,32 @@ protected:
 
 private:
     void enter_run_queue() {
-        uint8_t min_confidence     = std::min(existence_confidence(), sync_confidence_);
-        uint16_t weighted_priority = (priority_ - 256) << (4 * min_confidence);
-        CfsScheduler<Shape>::Entity::enter_run_queue(weighted_priority);
+        // Every send defers the next one of the same change 16 times further, so repeats only use
+        // what new changes leave. With more sends per change, the same steps are spread over them.
+        uint8_t min_confidence = std::min(existence_confidence(), sync_confidence_);
+        int level              = min_confidence * default_update_times / context_.update_times_;
+        uint32_t delay         = std::min<uint32_t>((256 - priority_) << (4 * level), 65535);
+        Entity::enter_run_queue(context_.scheduler_, static_cast<uint16_t>(65536 - delay));
+    }
+    void leave_run_queue() { Entity::leave_run_queue(context_.scheduler_); }
+
+    // The id of the shape always comes from the context it was constructed with.
+    bool try_assign_id() { return Descriptor::try_assign_id(context_.remote_shape_); }
+    bool predict_try_assign_id(uint8_t& existence_confidence) const {
+        return Descriptor::predict_try_assign_id(context_.remote_shape_, existence_confidence);
+    }
+    void release_id() { Descriptor::release_id(context_.remote_shape_); }
+    void enable_swapping() { Descriptor::enable_swapping(context_.remote_shape_); }
+    void disable_swapping() { Descriptor::disable_swapping(context_.remote_shape_); }
+    uint8_t increase_existence_confidence() {
+        return Descriptor::increase_existence_confidence(context_.remote_shape_);
     }
 
     void id_revoked() {
         // This is a callback indicating that the remote id that this shape once had
         // is no longer associated with it.
         // Called by RemoteShape<Shape>::Descriptor.
-        if (visible_) {
+        if (shown()) {
             // Re-enter the update queue to try to get a new id.
             set_modified();
         } else {
@@ -204,7 +375,7 @@ private:
 
     command::Field update() {
         // This is a callback indicating that the shape is being updated.
-        // Called by CfsScheduler<Shape>.
+        // Called by CfsScheduler.
 
         if (!has_id() && !try_assign_id()) {
             // TODO: Print error message.
@@ -214,25 +385,25 @@ private:
             return no_operation_description();
         }
 
+        auto update_times = context_.update_times_;
         if (existence_confidence() == 0) {
             // Optimization: Always consider it synchronized when remote shape does not exist.
-            sync_confidence_ = max_update_times;
+            sync_confidence_ = update_times;
         }
 
         command::Field field;
 
         // Optimization1: Stop adding when shape is invisible.
         // Optimization2: Prevent continuous modification.
-        if (visible_
+        if (shown()
             && (existence_confidence() <= sync_confidence_
-                || (last_time_modified_ && existence_confidence() < max_update_times))) {
+                || (last_time_modified_ && existence_confidence() < update_times))) {
             // Send add packet
             last_time_modified_ = false;
             field               = command::Field{[this](std::byte* buffer) {
                 return write_full_description_field(buffer, Operation::ADD);
             }};
-            if (increase_existence_confidence() < max_update_times
-                || sync_confidence_ < max_update_times)
+            if (increase_existence_confidence() < update_times || sync_confidence_ < update_times)
                 enter_run_queue();
         } else {
             // Send modify packet
@@ -243,7 +414,7 @@ private:
             // No need to compare existence_confidence here.
             // Because either the shape is not visible here, no need to send add packet.
             // Or existence_confidence > sync_confidence, only the min value needs to be considered.
-            if (++sync_confidence_ < max_update_times)
+            if (++sync_confidence_ < update_times)
                 enter_run_queue();
         }
 
@@ -252,7 +423,7 @@ private:
 
     size_t write_full_description_field(std::byte* buffer, Operation operation) {
         size_t written =
-            visible_ ? write_description_field(buffer) : write_invisible_description_field(buffer);
+            shown() ? write_description_field(buffer) : write_invisible_description_field(buffer);
         auto& description = *std::launder(reinterpret_cast<DescriptionField*>(buffer));
 
         // No special meaning, just to ensure no duplication
@@ -260,8 +431,7 @@ private:
         description.name[1] = 0xef;
         description.name[2] = 0xfe;
 
-        // We only use layer 0
-        description.part1.layer = 0;
+        description.part1.layer = layer_;
 
         description.part1.operation_type = operation;
 
@@ -285,7 +455,39 @@ private:
         return sizeof(DescriptionField);
     }
 
-    static constexpr uint8_t max_update_times = 4;
+    bool shown() const { return visible_ && context_.layer_visible(layer_); }
+
+    // Sends the shape again from scratch, after its remote copy was deleted.
+    void redraw() {
+        if (!shown())
+            return;
+        sync_confidence_ = 0;
+        enter_run_queue();
+    }
+
+    void link_layer() {
+        layer_prev_ = nullptr;
+        layer_next_ = context_.layer_heads_[layer_];
+        if (layer_next_)
+            layer_next_->layer_prev_ = this;
+        context_.layer_heads_[layer_] = this;
+    }
+    void unlink_layer() {
+        (layer_prev_ ? layer_prev_->layer_next_ : context_.layer_heads_[layer_]) = layer_next_;
+        if (layer_next_)
+            layer_next_->layer_prev_ = layer_prev_;
+    }
+
+    static constexpr double target_delivery       = 0.99;
+    static constexpr double max_loss_rate         = 0.75;
+    static constexpr uint8_t default_update_times = 4;
+    // Bounded by the width of sync_confidence_.
+    static constexpr uint8_t max_update_times = 16;
+
+    Context& context_;
+
+    Shape *layer_prev_ = nullptr, *layer_next_ = nullptr;
+    uint8_t layer_     = 0;
 
     uint8_t priority_            = 15;
     uint8_t sync_confidence_ : 5 = max_update_times;
@@ -296,10 +498,12 @@ private:
 
 class Line : public Shape {
 public:
-    Line() = default;
+    explicit Line(Context& context)
+        : Shape(context) {}
     Line(
-        Color color, uint16_t width, uint16_t x, uint16_t y, uint16_t x2, uint16_t y2,
-        bool visible = true) {
+        Context& context, Color color, uint16_t width, uint16_t x, uint16_t y, uint16_t x2,
+        uint16_t y2, bool visible = true)
+        : Shape(context) {
         part3_.color = color;
         part2_.width = width;
         part2_.x     = x;
@@ -361,10 +565,12 @@ private:
 
 class Circle : public Shape {
 public:
-    Circle() = default;
+    explicit Circle(Context& context)
+        : Shape(context) {}
     Circle(
-        Color color, uint16_t width, uint16_t x, uint16_t y, uint16_t rx, uint16_t ry,
-        bool visible = true) {
+        Context& context, Color color, uint16_t width, uint16_t x, uint16_t y, uint16_t rx,
+        uint16_t ry, bool visible = true)
+        : Shape(context) {
         part3_.color = color;
         part2_.width = width;
         part2_.x     = x;
@@ -429,10 +635,12 @@ protected:
 
 class Rectangle : public Shape {
 public:
-    Rectangle() = default;
+    explicit Rectangle(Context& context)
+        : Shape(context) {}
     Rectangle(
-        Color color, uint16_t width, uint16_t x, uint16_t y, uint16_t x2, uint16_t y2,
-        bool visible = true) {
+        Context& context, Color color, uint16_t width, uint16_t x, uint16_t y, uint16_t x2,
+        uint16_t y2, bool visible = true)
+        : Shape(context) {
         part3_.color = color;
         part2_.width = width;
         part2_.x     = x;
@@ -492,10 +700,11 @@ protected:
 
 class Arc : public Shape {
 public:
-    Arc() = default;
-    Arc(Color color, uint16_t width, uint16_t x, uint16_t y, uint16_t angle_start,
-        uint16_t angle_end, uint16_t rx, uint16_t ry, bool visible = true)
-        : Arc() {
+    explicit Arc(Context& context)
+        : Shape(context) {}
+    Arc(Context& context, Color color, uint16_t width, uint16_t x, uint16_t y,
+        uint16_t angle_start, uint16_t angle_end, uint16_t rx, uint16_t ry, bool visible = true)
+        : Arc(context) {
         angle_start_ = angle_start;
         angle_end_   = angle_end;
 
@@ -598,11 +807,12 @@ protected:
 
 class Integer : public Shape {
 public:
-    Integer() = default;
+    explicit Integer(Context& context)
+        : Shape(context) {}
     Integer(
-        Color color, uint16_t font_size, uint16_t width, uint16_t x, uint16_t y, int32_t value,
-        bool visible = true)
-        : Integer() {
+        Context& context, Color color, uint16_t font_size, uint16_t width, uint16_t x, uint16_t y,
+        int32_t value, bool visible = true)
+        : Integer(context) {
         color_     = color;
         font_size_ = font_size;
 
@@ -711,11 +921,14 @@ protected:
 
 class Text : public Shape {
 public:
-    Text() { value_ = nullptr; };
+    explicit Text(Context& context)
+        : Shape(context) {
+        value_ = nullptr;
+    };
     Text(
-        Color color, uint16_t font_size, uint16_t width, uint16_t x, uint16_t y, const char* value,
-        bool visible = true)
-        : Text() {
+        Context& context, Color color, uint16_t font_size, uint16_t width, uint16_t x, uint16_t y,
+        const char* value, bool visible = true)
+        : Text(context) {
         color_     = color;
         font_size_ = font_size;
 
@@ -6,13 +6,14 @@ namespace rmcs_referee::app::ui {
 
 class Crosshair {
 public:
-    Crosshair(Shape::Color color, uint16_t x, uint16_t y, bool visible = true)
+    Crosshair(
+        Shape::Context& context, Shape::Color color, uint16_t x, uint16_t y, bool visible = true)
         : guidelines_(
-              {color, 2, (uint16_t)(x - r2), y, (uint16_t)(x - r1), y, visible},
-              {color, 2, (uint16_t)(x + r1), y, (uint16_t)(x + r2), y, visible},
-              {color, 2, x, (uint16_t)(y + r2), x, (uint16_t)(y + r1), visible},
-              {color, 2, x, (uint16_t)(y - r1), x, (uint16_t)(y - r2), visible})
-        , center_(color, 2, x, y, 1, 1) {}
+              {context, color, 2, (uint16_t)(x - r2), y, (uint16_t)(x - r1), y, visible},
+              {context, color, 2, (uint16_t)(x + r1), y, (uint16_t)(x + r2), y, visible},
+              {context, color, 2, x, (uint16_t)(y + r2), x, (uint16_t)(y + r1), visible},
+              {context, color, 2, x, (uint16_t)(y - r1), x, (uint16_t)(y - r2), visible})
+        , center_(context, color, 2, x, y, 1, 1) {}
 
     void set_visible(bool value) {
         for (auto& line : guidelines_)
@@ -20,6 +21,12 @@ public:
         center_.set_visible(value);
     }
 
+    void set_layer(uint8_t layer) {
+        for (auto& line : guidelines_)
+            line.set_layer(layer);
+        center_.set_layer(layer);
+    }
+
 private:
     static constexpr uint16_t r1 = 8, r2 = 24;
 
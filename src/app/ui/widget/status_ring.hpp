@@ -6,6 +6,7 @@
 #include <cmath>
 #include <cstdint>
 #include <cstring>
+#include <initializer_list>
 #include <numbers>
 #include <robot_color.hpp>
 
@@ -13,7 +14,24 @@ namespace rmcs_referee::app::ui {
 
 class StatusRing {
 public:
-    StatusRing() {
+    explicit StatusRing(Shape::Context& context)
+        : supercap_status_(context)
+        , supercap_enable_status_(context)
+        , supercap_voltage_(context)
+        , battery_status_(context)
+        , battery_voltage_(context)
+        , friction_wheel_speed_(context)
+        , bullet_status_(context)
+        , bullet_allowance_(context)
+        , line_left_center_(context)
+        , line_right_center_(context)
+        , arc_left_up_(context)
+        , arc_left_down_(context)
+        , arc_right_up_(context)
+        , arc_right_down_(context)
+        , bullet_scales_number_{
+              Integer{context}, Integer{context}, Integer{context}, Integer{context}}
+        , bullet_scales_{Arc{context}, Arc{context}, Arc{context}, Arc{context}} {
         supercap_status_.set_x(x_center);
         supercap_status_.set_y(y_center);
         supercap_status_.set_r(visible_radius - width_ring + 5);
@@ -254,6 +272,23 @@ public:
         }
     }
 
+    // The rarely changing frame and scales can then be kept while the bars are redrawn.
+    void set_layers(uint8_t dynamic_layer, uint8_t static_layer) {
+        for (Shape* shape : std::initializer_list<Shape*>{
+                 &supercap_status_, &supercap_enable_status_, &supercap_voltage_, &battery_status_,
+                 &battery_voltage_, &friction_wheel_speed_, &bullet_status_, &bullet_allowance_})
+            shape->set_layer(dynamic_layer);
+
+        for (Shape* shape : std::initializer_list<Shape*>{
+                 &line_left_center_, &line_right_center_, &arc_left_up_, &arc_left_down_,
+                 &arc_right_up_, &arc_right_down_})
+            shape->set_layer(static_layer);
+        for (auto& number : bullet_scales_number_)
+            number.set_layer(static_layer);
+        for (auto& scale : bullet_scales_)
+            scale.set_layer(static_layer);
+    }
+
 private:
     void
         set_limits(double supercap_limit, double battery_limit, double friction_limit, int16_t bullet_limit) {
@@ -1,12 +1,20 @@
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <span>
+#include <string>
 
 #include <rclcpp/node.hpp>
 #include <rmcs_executor/component.hpp>
-#include <serial/serial.h>
-#include <serial_util/crc/dji_crc.hpp>
 
 #include "command/field.hpp"
+#include "command/statistics.hpp"
+#include "command/tx_queue.hpp"
+#include "command/uplink_frame.hpp"
 #include "frame.hpp"
+#include "transport.hpp"
+#include "utility/parameter.hpp"
+#include "utility/token_bucket.hpp"
 
 namespace rmcs_referee {
 using namespace command;
@@ -17,66 +25,190 @@ class Command
 public:
     Command()
         : Node{get_component_name(), rclcpp::NodeOptions{}.automatically_declare_parameters_from_overrides(true)}
-        , next_sent_(std::chrono::steady_clock::time_point::min())
-        , interaction_next_sent_(std::chrono::steady_clock::time_point::min())
-        , map_marker_next_sent_(std::chrono::steady_clock::time_point::min())
-        , text_display_next_sent_(std::chrono::steady_clock::time_point::min()) {
+        , channels_{
+              // command::Interaction multiplexes queued 0x0301 frames with its other sub-channels.
+              Channel{"interaction", 0x0301, 25.0, 8.0, true}, // 25hz max to reduce packet loss
+              Channel{"map_marker", 0x0307, 1.0, 1.0},         // 1hz max
+              Channel{"text_display", 0x0308, 3.0, 1.0},       // 3hz max
+          } {
 
-        register_input("/referee/serial", serial_, false);
+        register_input("/referee/transport", transport_, false);
 
-        register_input("/referee/command/interaction", interaction_field_, false);
-        register_input("/referee/command/map_marker", map_marker_field_, false);
-        register_input("/referee/command/text_display", text_display_field_, false);
+        register_input("/referee/command/queue", queue_, false);
+
+        register_output("/referee/command/statistics", statistics_);
+
+        // Byte credit replaces a single next-send timestamp: sending is not rounded up to the next
+        // tick, and several small frames may leave in the same tick when the credit allows.
+        link_bandwidth_ = utility::get_double_parameter_or(*this, "link_bandwidth", 3720.0);
+        link_credit_    = utility::TokenBucket{
+            link_bandwidth_, utility::get_double_parameter_or(*this, "link_burst", 128.0)};
+        statistics_->theoretical_bandwidth = link_bandwidth_;
+        for (size_t i = 0; i < channels_.size(); ++i) {
+            auto& channel = channels_[i];
+            register_input("/referee/command/" + channel.name, channel.field, false);
+
+            // Burst of one frame: a channel never sends faster than its rate, as before.
+            auto rate      = utility::get_double_parameter_or(
+                *this, channel.name + "_rate", channel.default_rate);
+            channel.bucket = utility::TokenBucket{rate, 1.0};
+            channel.weight = utility::get_double_parameter_or(
+                *this, channel.name + "_weight", channel.default_weight);
+
+            statistics_->channels[i].command_id = channel.command_id;
+        }
     }
 
     void before_updating() override {
-        if (!interaction_field_.ready())
-            interaction_field_.bind_directly(empty_field_);
-        if (!map_marker_field_.ready())
-            map_marker_field_.bind_directly(empty_field_);
-        if (!text_display_field_.ready())
-            text_display_field_.bind_directly(empty_field_);
+        for (auto& channel : channels_) {
+            // Without its multiplexer, the channel serves the queued frames itself.
+            channel.serves_queue = !channel.multiplexes_queue || !channel.field.ready();
+            if (!channel.field.ready())
+                channel.field.bind_directly(empty_field_);
+        }
+        if (!queue_.ready())
+            queue_.bind_directly(empty_queue_);
     }
 
     void update() override {
-        if (!serial_.ready())
+        if (!transport_.ready())
             return;
 
-        using namespace std::chrono_literals;
-        auto now     = std::chrono::steady_clock::now();
-        auto& serial = const_cast<serial::Serial&>(*serial_);
+        auto now        = Clock::now();
+        auto& transport = const_cast<Transport&>(*transport_);
 
-        if (now < next_sent_)
-            return;
+        update_link_utilization(now);
 
-        constexpr auto one_second = std::chrono::steady_clock::duration(1s);
-        size_t data_length;
-        if (now >= interaction_next_sent_ && !interaction_field_->empty()) {
-            interaction_next_sent_ = now + (one_second / 25); // 25hz max to reduce packet loss
-            frame_.body.command_id = 0x0301;
-            data_length            = interaction_field_->write(frame_.body.data);
-        } else if (now >= map_marker_next_sent_ && !map_marker_field_->empty()) {
-            map_marker_next_sent_  = now + (one_second / 1);  // 1hz max
-            frame_.body.command_id = 0x0307;
-            data_length            = map_marker_field_->write(frame_.body.data);
-        } else if (now >= text_display_next_sent_ && !text_display_field_->empty()) {
-            text_display_next_sent_ = now + (one_second / 3); // 3hz max
-            frame_.body.command_id  = 0x0308;
-            data_length             = text_display_field_->write(frame_.body.data);
-        } else {
-            return;
+        link_credit_.refill(now);
+        for (auto& channel : channels_)
+            channel.bucket.refill(now);
+
+        // The size of a frame is only known once written, so any positive credit allows a frame
+        // and the credit may go negative, to be paid back before the next one.
+        for (auto& channel : channels_)
+            channel.dropped = false;
+        while (link_credit_.tokens() > 0) {
+            auto selected = select_channel();
+            if (!selected)
+                break;
+            // A full transport takes nothing more this tick.
+            size_t frame_size = 0;
+            if (!send(transport, *selected, frame_size))
+                break;
+            link_credit_.consume(static_cast<double>(frame_size));
+        }
+
+        for (size_t i = 0; i < channels_.size(); ++i) {
+            if (pending_field(channels_[i]) && !channels_[i].bucket.available())
+                ++statistics_->channels[i].throttled;
         }
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Channel {
+        Channel(
+            std::string name, uint16_t command_id, double default_rate, double default_weight,
+            bool multiplexes_queue = false)
+            : name(std::move(name))
+            , command_id(command_id)
+            , default_rate(default_rate)
+            , default_weight(default_weight)
+            , multiplexes_queue(multiplexes_queue) {}
+
+        std::string name;
+        uint16_t command_id;
+        double default_rate, default_weight;
+        bool multiplexes_queue, serves_queue = true;
+
+        InputInterface<Field> field;
 
-        // TODO(qzh): Assert data length.
+        utility::TokenBucket bucket;
+        double weight;
+        double virtual_start = 0, virtual_finish = 0;
+        // Whether the field was dropped this tick, it would only be dropped again.
+        bool dropped = false;
+    };
+
+    // Queued one-shot frames go before the channel input, which only ever holds the latest state.
+    const Field* pending_field(const Channel& channel) const {
+        if (channel.serves_queue) {
+            if (auto queued = queue_->front(channel.command_id))
+                return queued;
+        }
+        return channel.field->empty() ? nullptr : &*channel.field;
+    }
+
+    Channel* select_channel() {
+        Channel* selected = nullptr;
+        for (auto& channel : channels_) {
+            if (channel.dropped || !pending_field(channel) || !channel.bucket.available())
+                continue;
+            // Weighted fair queueing: serve the smallest virtual finish time. A channel coming
+            // back from idle starts at the current virtual time instead of its stale one, so it
+            // cannot claim bandwidth for the time it had nothing to send.
+            channel.virtual_start = std::max(channel.virtual_finish, virtual_time_);
+            if (!selected || channel.virtual_start < selected->virtual_start)
+                selected = &channel;
+        }
+        return selected;
+    }
 
-        frame_.header.sof         = sof_value;
-        frame_.header.data_length = data_length;
-        frame_.header.sequence    = 0;
-        serial_util::dji_crc::append_crc8(frame_.header);
+    // Returns false if the transport refused the frame, puts the number of bytes put on the link
+    // in `frame_size`. Only frames the transport took cost a token and count as sent.
+    bool send(Transport& transport, Channel& selected, size_t& frame_size) {
+        auto& queue = const_cast<TxQueue&>(*queue_);
+        auto queued = selected.serves_queue ? queue.claim(selected.command_id) : nullptr;
+        auto& field = queued ? *queued : *selected.field;
 
-        auto frame_size =
-            sizeof(frame_.header) + sizeof(frame_.body.command_id) + data_length + sizeof(uint16_t);
-        serial_util::dji_crc::append_crc16(&frame_, frame_size);
+        // A prepared frame is already complete, nothing is serialized or checksummed here.
+        auto prepared = field.prepared_frame();
+        auto accepted = prepared.empty()
+                          ? serialize_and_write(transport, selected.command_id, field, frame_size)
+                          : write_prepared(transport, prepared, frame_size);
+        // Whoever claimed a queued frame, Command or the multiplexer writing the field, a frame
+        // the transport refused stays queued and is retried next time.
+        queue.settle(accepted);
+
+        auto& channel_statistics = statistics_->channels[&selected - channels_.data()];
+        if (!accepted) {
+            ++channel_statistics.refused_frames;
+            return false;
+        }
+        if (!frame_size) {
+            ++channel_statistics.dropped_frames;
+            selected.dropped = true;
+            return true;
+        }
+
+        selected.bucket.consume();
+        virtual_time_           = selected.virtual_start;
+        selected.virtual_finish = selected.virtual_start + frame_size / selected.weight;
+
+        ++channel_statistics.sent_frames;
+        channel_statistics.sent_bytes += frame_size;
+        statistics_->link_bytes += frame_size;
+        return true;
+    }
+
+    // Both return false if the transport refused the frame and it should be retried, and put the
+    // size of the frame in `frame_size`, 0 if it was dropped.
+    bool serialize_and_write(
+        Transport& transport, uint16_t command_id, const Field& field, size_t& frame_size) {
+        size_t data_length = field.write(frame_.body.data);
+
+        // Fixed-size payloads are checked at compile time by write_field<command_id>(), this only
+        // catches fields of dynamic size.
+        if (data_length > max_data_length(command_id)) [[unlikely]] {
+            RCLCPP_ERROR(
+                get_logger(), "Dropped frame 0x%04x: %zu bytes exceed the limit of %zu", command_id,
+                data_length, max_data_length(command_id));
+            frame_size = 0;
+            return true;
+        }
+
+        frame_size = seal_frame(frame_, command_id, data_length);
 
         // std::stringstream ss;
         // auto buffer = reinterpret_cast<uint8_t*>(&frame_);
@@ -84,25 +216,55 @@ public:
         //     ss << std::hex << std::setfill('0') << std::setw(2) << (int)(buffer[i]) << " ";
         // RCLCPP_INFO(get_logger(), "%zu: %s", frame_size, ss.str().c_str());
 
-        serial.write(reinterpret_cast<uint8_t*>(&frame_), frame_size);
-        next_sent_ = now + (one_second / 3720 * frame_size);
+        if (!transport.write({reinterpret_cast<const std::byte*>(&frame_), frame_size})) {
+            RCLCPP_WARN(get_logger(), "Failed to send frame 0x%04x", command_id);
+            return false;
+        }
+        return true;
     }
 
-private:
-    InputInterface<serial::Serial> serial_;
-    Frame frame_;
+    bool write_prepared(Transport& transport, std::span<const std::byte> frame, size_t& frame_size) {
+        frame_size = frame.size();
+        if (!transport.write(frame)) {
+            RCLCPP_WARN(get_logger(), "Failed to send prepared frame");
+            return false;
+        }
+        return true;
+    }
+
+    void update_link_utilization(Clock::time_point now) {
+        using namespace std::chrono_literals;
+        if (now < utilization_window_end_)
+            return;
+
+        auto window_bytes = statistics_->link_bytes - utilization_window_bytes_;
+        if (utilization_window_end_ != Clock::time_point{}) {
+            auto window = std::chrono::duration<double>(now - utilization_window_end_ + 1s).count();
+            statistics_->achieved_bandwidth = static_cast<double>(window_bytes) / window;
+            statistics_->link_utilization   = statistics_->achieved_bandwidth / link_bandwidth_;
+        }
+
+        utilization_window_bytes_ = statistics_->link_bytes;
+        utilization_window_end_   = now + 1s;
+    }
+
+    InputInterface<Transport> transport_;
+    UplinkFrame frame_;
 
     Field empty_field_;
-    std::chrono::steady_clock::time_point next_sent_;
 
-    InputInterface<Field> interaction_field_;
-    std::chrono::steady_clock::time_point interaction_next_sent_;
+    InputInterface<TxQueue> queue_;
+    TxQueue empty_queue_;
+
+    double link_bandwidth_;
+    utility::TokenBucket link_credit_;
 
-    InputInterface<Field> map_marker_field_;
-    std::chrono::steady_clock::time_point map_marker_next_sent_;
+    std::array<Channel, TxStatistics::channel_count> channels_;
+    double virtual_time_ = 0;
 
-    InputInterface<Field> text_display_field_;
-    std::chrono::steady_clock::time_point text_display_next_sent_;
+    OutputInterface<TxStatistics> statistics_;
+    Clock::time_point utilization_window_end_;
+    uint64_t utilization_window_bytes_ = 0;
 };
 
 } // namespace rmcs_referee
@@ -5,49 +5,174 @@
 #include <cstring>
 
 #include <new>
+#include <span>
 #include <type_traits>
 #include <utility>
 
+#include "frame.hpp"
+
 namespace rmcs_referee::command {
 
-class Field {
+// Type-erased writer of a frame payload, stored inline without ever allocating.
+// Functors up to `inline_size` bytes are accepted, so a producer may capture a snapshot of the
+// values to send instead of `this`. Captures that are not trivially copyable, or are move-only,
+// are handled by a small vtable; trivial ones are moved with a plain copy of the storage.
+template <size_t inline_size>
+class BasicField {
 public:
-    constexpr Field() { write_ = &do_nothing; }
+    constexpr BasicField()
+        : vtable_(&empty_vtable) {}
 
     template <typename F>
-    requires requires(const F& f, std::byte* buffer) {
+    requires(!std::is_same_v<F, BasicField>) && requires(const F& f, std::byte* buffer) {
         { f(buffer) } -> std::convertible_to<size_t>;
-    } constexpr explicit Field(F functor) {
-        static_assert(sizeof(functor) <= sizeof(intptr_t));
-        static_assert(std::is_trivially_destructible_v<F>);
+    } constexpr explicit BasicField(F functor) {
+        static_assert(sizeof(F) <= inline_size, "Functor does not fit in the field storage");
+        static_assert(alignof(F) <= alignof(std::max_align_t));
+        static_assert(std::is_nothrow_move_constructible_v<F>);
 
         ::new (&storage_) F(std::move(functor));
-        write_ = [](const intptr_t& storage, std::byte* buffer) {
-            return (*std::launder(reinterpret_cast<const F*>(&storage)))(buffer);
-        };
+        vtable_ = &vtable_for<F>;
+    }
+
+    // Refers to a complete frame, header and crc included, serialized once by the producer.
+    // Command sends it as is; anything else writing the field gets a copy of its payload.
+    // The frame must stay alive and unchanged until it was sent.
+    static BasicField prepared(std::span<const std::byte> frame) {
+        static_assert(sizeof(frame) <= inline_size);
+        BasicField field;
+        ::new (&field.storage_) std::span<const std::byte>(frame);
+        field.vtable_ = &prepared_vtable;
+        return field;
     }
 
-    [[nodiscard]] constexpr explicit operator bool() const { return write_ != &do_nothing; }
-    [[nodiscard]] constexpr bool empty() const { return write_ == &do_nothing; }
+    BasicField(const BasicField&)            = delete;
+    BasicField& operator=(const BasicField&) = delete;
+
+    BasicField(BasicField&& other) noexcept { take(other); }
+    BasicField& operator=(BasicField&& other) noexcept {
+        if (this != &other) {
+            reset();
+            take(other);
+        }
+        return *this;
+    }
 
-    size_t write(std::byte* buffer) const { return write_(storage_, buffer); };
+    constexpr ~BasicField() { reset(); }
+
+    [[nodiscard]] constexpr explicit operator bool() const { return vtable_ != &empty_vtable; }
+    [[nodiscard]] constexpr bool empty() const { return vtable_ == &empty_vtable; }
+
+    size_t write(std::byte* buffer) const { return vtable_->write(storage_, buffer); };
+
+    // The whole frame of a prepared field, empty otherwise.
+    [[nodiscard]] std::span<const std::byte> prepared_frame() const {
+        if (vtable_ != &prepared_vtable)
+            return {};
+        return *std::launder(reinterpret_cast<const std::span<const std::byte>*>(storage_));
+    }
 
 private:
-    static constexpr size_t do_nothing(const intptr_t&, std::byte*) { return 0; };
+    struct VTable {
+        size_t (*write)(const std::byte* storage, std::byte* buffer);
+        // Both null when the functor is trivially copyable and destructible.
+        void (*move)(std::byte* from, std::byte* to) noexcept;
+        void (*destroy)(std::byte* storage) noexcept;
+    };
+
+    template <typename F>
+    static constexpr bool trivial =
+        std::is_trivially_copyable_v<F> && std::is_trivially_destructible_v<F>;
+
+    template <typename F>
+    static constexpr VTable vtable_for = {
+        [](const std::byte* storage, std::byte* buffer) -> size_t {
+            return (*std::launder(reinterpret_cast<const F*>(storage)))(buffer);
+        },
+        trivial<F> ? nullptr : +[](std::byte* from, std::byte* to) noexcept {
+            auto& functor = *std::launder(reinterpret_cast<F*>(from));
+            ::new (to) F(std::move(functor));
+            functor.~F();
+        },
+        trivial<F> ? nullptr : +[](std::byte* storage) noexcept {
+            std::launder(reinterpret_cast<F*>(storage))->~F();
+        },
+    };
+
+    static constexpr size_t do_nothing(const std::byte*, std::byte*) { return 0; };
+    static constexpr VTable empty_vtable = {&do_nothing, nullptr, nullptr};
+
+    // Skips the 5-byte header and the command id in front of the payload, and the crc16 after it.
+    static size_t write_prepared(const std::byte* storage, std::byte* buffer) {
+        auto frame   = *std::launder(reinterpret_cast<const std::span<const std::byte>*>(storage));
+        auto payload = frame.subspan(7, frame.size() - 9);
+        std::memcpy(buffer, payload.data(), payload.size());
+        return payload.size();
+    }
+    static constexpr VTable prepared_vtable = {&write_prepared, nullptr, nullptr};
+
+    void take(BasicField& other) noexcept {
+        vtable_ = other.vtable_;
+        if (vtable_->move)
+            vtable_->move(other.storage_, storage_);
+        else
+            std::memcpy(storage_, other.storage_, inline_size);
+        other.vtable_ = &empty_vtable;
+    }
+
+    constexpr void reset() noexcept {
+        if (vtable_->destroy)
+            vtable_->destroy(storage_);
+        vtable_ = &empty_vtable;
+    }
 
-    intptr_t storage_;
-    size_t (*write_)(const intptr_t&, std::byte*);
+    alignas(std::max_align_t) std::byte storage_[inline_size];
+    const VTable* vtable_;
 };
 
-inline size_t write_field(std::byte*) { return 0; }
+// Large enough for a `this` pointer plus a few snapshot values.
+using Field = BasicField<32>;
 
+// Largest frame data the referee accepts for each uplink command, sub-headers included.
+constexpr size_t max_data_length(uint16_t command_id) {
+    switch (command_id) {
+    case 0x0301: return 6 + 113; // Interaction header and user data
+    case 0x0307: return 105;
+    case 0x0308: return 34;
+    default: return frame_data_max_length;
+    }
+}
+
+namespace detail {
+template <typename T>
+struct SerializedSize {
+    static constexpr size_t max   = sizeof(T);
+    static constexpr bool bounded = true;
+};
+template <size_t inline_size>
+struct SerializedSize<BasicField<inline_size>> {
+    static constexpr size_t max   = 0;
+    static constexpr bool bounded = false;
+};
+} // namespace detail
+
+// Upper bound of what write_field() writes for the arguments, not counting nested fields.
+template <typename... Ts>
+constexpr size_t max_serialized_size = (detail::SerializedSize<Ts>::max + ... + 0);
+// Whether the size is fully known at compile time, i.e. there is no nested field.
 template <typename... Ts>
-inline size_t write_field(std::byte*, const Field&, const Ts&...);
+constexpr bool bounded_serialized_size = (detail::SerializedSize<Ts>::bounded && ...);
+
+inline size_t write_field(std::byte*) { return 0; }
+
+template <size_t inline_size, typename... Ts>
+inline size_t write_field(std::byte*, const BasicField<inline_size>&, const Ts&...);
 template <typename T, typename... Ts>
 inline size_t write_field(std::byte*, const T&, const Ts&...);
 
-template <typename... Ts>
-inline size_t write_field(std::byte* buffer, const Field& package, const Ts&... other_data) {
+template <size_t inline_size, typename... Ts>
+inline size_t
+    write_field(std::byte* buffer, const BasicField<inline_size>& package, const Ts&... other_data) {
     auto written = package.write(buffer);
     return written + write_field(buffer + written, other_data...);
 }
@@ -57,6 +182,16 @@ inline size_t write_field(std::byte* buffer, const T& data, const Ts&... other_d
     return sizeof(data) + write_field(buffer + sizeof(data), other_data...);
 }
 
+// Same as write_field(), rejecting at compile time what can never fit in the command's frame.
+// Nested fields are only known at runtime and are checked by Command before sending.
+template <uint16_t command_id, typename... Ts>
+inline size_t write_field(std::byte* buffer, const Ts&... data) {
+    static_assert(
+        max_serialized_size<Ts...> <= max_data_length(command_id),
+        "Payload exceeds the protocol limit of the command");
+    return write_field(buffer, data...);
+}
+
 #define MAKE_FIELD(...)                                                        \
     ::rmcs_referee::command::Field {                                           \
         [this](std::byte* buffer) { return write_field(buffer, __VA_ARGS__); } \
@@ -1,7 +1,15 @@
+#include <array>
+#include <chrono>
+#include <string>
+#include <utility>
+
 #include <rclcpp/node.hpp>
 #include <rmcs_executor/component.hpp>
 
 #include "command/field.hpp"
+#include "command/tx_queue.hpp"
+#include "utility/parameter.hpp"
+#include "utility/token_bucket.hpp"
 
 namespace rmcs_referee::command {
 
@@ -12,49 +20,162 @@ public:
     Interaction()
         : Node{
               get_component_name(),
-              rclcpp::NodeOptions{}.automatically_declare_parameters_from_overrides(true)} {
+              rclcpp::NodeOptions{}.automatically_declare_parameters_from_overrides(true)}
+        , channels_{
+              // 0x0301 frames submitted to TxQueue, sentry decisions among them. Command leaves
+              // them to this multiplexer, so a decision changing every tick gets its share of the
+              // 0x0301 rate like any other sub-channel instead of all of it.
+              Channel{"queued", 1.0, 1.0},
+              Channel{"communicate", 1.0, 0.0},
+              Channel{"ui", 1.0, 0.0},
+          } {
+
+        register_input("/referee/command/queue", queue_, false);
+
+        for (auto& channel : channels_) {
+            auto prefix = "/referee/command/interaction/" + channel.name;
+            if (&channel != &queued_channel())
+                register_input(prefix, channel.field, false);
+            register_output(prefix + "/sent", channel.sent, 0);
+            register_output(prefix + "/starved", channel.starved, 0);
 
-        register_input(
-            "/referee/command/interaction/sentry_decision", sentry_decision_field_, false);
-        register_input("/referee/command/interaction/communicate", communicate_field_, false);
-        register_input("/referee/command/interaction/ui", ui_field_, false);
+            channel.weight = utility::get_double_parameter_or(
+                *this, channel.name + "_weight", channel.default_weight);
+            auto min_rate  = utility::get_double_parameter_or(
+                *this, channel.name + "_min_rate", channel.default_min_rate);
+            channel.guarantee = utility::TokenBucket{min_rate, 1.0};
+        }
 
         register_output("/referee/command/interaction", interaction_field_);
     }
 
     void before_updating() override {
-        if (!sentry_decision_field_.ready())
-            sentry_decision_field_.bind_directly(empty_field_);
-        if (!communicate_field_.ready())
-            communicate_field_.bind_directly(empty_field_);
-        if (!ui_field_.ready())
-            ui_field_.bind_directly(empty_field_);
+        if (!queue_.ready())
+            queue_.bind_directly(empty_queue_);
+        queued_channel().field.bind_directly(queued_field_);
+        for (auto& channel : channels_) {
+            if (!channel.field.ready())
+                channel.field.bind_directly(empty_field_);
+        }
     }
 
     void update() override {
-        if (*sentry_decision_field_)
-            *interaction_field_ = *sentry_decision_field_;
-        else if (*communicate_field_)
-            *interaction_field_ = *communicate_field_;
-        else if (*ui_field_)
-            *interaction_field_ = *ui_field_;
-        else
-            *interaction_field_ = Field{};
+        // Frames only leave the queue once Command wrote them, after this update.
+        queued_field_ = queue_->front(0x0301)
+                          ? Field{[this](std::byte* buffer) { return write_queued(buffer); }}
+                          : Field{};
+
+        bool pending = false;
+        for (auto& channel : channels_)
+            pending |= !channel.field->empty();
+
+        // The sub-channel is chosen when Command actually writes the frame, so the multiplexer
+        // only accounts for frames that really went out at the 0x0301 rate.
+        *interaction_field_ =
+            pending ? Field{[this](std::byte* buffer) { return write_selected(buffer); }} : Field{};
     }
 
 private:
-    Field empty_field_;
+    using Clock = std::chrono::steady_clock;
 
-    InputInterface<Field> sentry_decision_field_;
-    InputInterface<Field> communicate_field_;
-    InputInterface<Field> ui_field_;
+    struct Channel {
+        Channel(std::string name, double default_weight, double default_min_rate)
+            : name(std::move(name))
+            , default_weight(default_weight)
+            , default_min_rate(default_min_rate) {}
 
-    struct __attribute__((packed)) InteractionHeader {
-        uint16_t command_id;
-        uint16_t sender_id;
-        uint16_t receiver_id;
+        std::string name;
+        double default_weight, default_min_rate;
+
+        InputInterface<Field> field;
+        OutputInterface<uint64_t> sent, starved;
+
+        double weight;
+        // Deficit round robin credit in bytes, may go negative since a frame's size is only known
+        // once written.
+        double deficit = 0;
+        utility::TokenBucket guarantee;
     };
 
+    size_t write_selected(std::byte* buffer) {
+        auto selected = select_channel(Clock::now());
+        if (!selected)
+            return 0;
+
+        auto written = selected->field->write(buffer);
+        selected->deficit -= static_cast<double>(written);
+        if (selected == &channels_[cursor_] && selected->deficit <= 0)
+            cursor_ = (cursor_ + 1) % channels_.size();
+        if (selected->guarantee.available())
+            selected->guarantee.consume();
+
+        ++*selected->sent;
+        for (auto& channel : channels_) {
+            if (&channel != selected && !channel.field->empty())
+                ++*channel.starved;
+        }
+        return written;
+    }
+
+    Channel& queued_channel() { return channels_[0]; }
+
+    // Claimed for Command, which pops the frame from the queue once the transport took it.
+    size_t write_queued(std::byte* buffer) {
+        auto field = const_cast<TxQueue&>(*queue_).claim(0x0301);
+        return field ? field->write(buffer) : 0;
+    }
+
+    Channel* select_channel(Clock::time_point now) {
+        // Minimum rates first: a channel whose guarantee is due is served whatever its deficit.
+        Channel* overdue = nullptr;
+        for (auto& channel : channels_) {
+            channel.guarantee.refill(now);
+            if (channel.field->empty() || !channel.guarantee.available()
+                || channel.guarantee.rate() <= 0)
+                continue;
+            if (!overdue || channel.guarantee.tokens() > overdue->guarantee.tokens())
+                overdue = &channel;
+        }
+        if (overdue)
+            return overdue;
+
+        // Deficit round robin: the channel holding the turn keeps it while it has credit left,
+        // then the next active channel earns its quantum. Idle channels lose their credit so they
+        // cannot save up bandwidth.
+        for (size_t visited = 0; visited < max_visits; ++visited) {
+            auto& channel = channels_[cursor_];
+            if (channel.field->empty()) {
+                channel.deficit = 0;
+            } else {
+                if (channel.deficit <= 0)
+                    channel.deficit += quantum * channel.weight;
+                if (channel.deficit > 0)
+                    return &channel;
+            }
+            cursor_ = (cursor_ + 1) % channels_.size();
+        }
+
+        // Only reached with non-positive weights.
+        for (auto& channel : channels_) {
+            if (!channel.field->empty())
+                return &channel;
+        }
+        return nullptr;
+    }
+
+    // Roughly one full interaction payload.
+    static constexpr double quantum    = 128.0;
+    static constexpr size_t max_visits = 64;
+
+    Field empty_field_;
+
+    InputInterface<TxQueue> queue_;
+    TxQueue empty_queue_;
+    Field queued_field_;
+
+    std::array<Channel, 3> channels_;
+    size_t cursor_ = 0;
+
     OutputInterface<Field> interaction_field_;
 };
 
@@ -1,21 +1,116 @@
+#include <cmath>
+#include <cstdint>
+
 #include <eigen3/Eigen/Eigen>
 
 #include <rclcpp/node.hpp>
-#include <rclcpp/publisher.hpp>
+#include <rmcs_executor/component.hpp>
+#include <rmcs_msgs/full_robot_id.hpp>
+#include <rmcs_msgs/robot_id.hpp>
 
-#include "rmcs_executor/component.hpp"
+#include "command/field.hpp"
+#include "command/interaction/communicate.hpp"
+#include "command/interaction/header.hpp"
 
 namespace rmcs_referee::command::interaction {
 
 class Communicate
     : public rmcs_executor::Component
     , public rclcpp::Node {
-
 public:
     Communicate()
-        : rclcpp::Node(get_component_name()) {}
+        : Node{
+              get_component_name(),
+              rclcpp::NodeOptions{}.automatically_declare_parameters_from_overrides(true)} {
+
+        // Number of the teammate to talk to, e.g. 7 for the sentry. The side follows our own id.
+        receiver_ = static_cast<uint16_t>(get_parameter_or("receiver", 7));
+
+        register_input("/referee/id", robot_id_);
+        register_input("/referee/communicate/inbox", inbox_, false);
+
+        register_input("/referee/communicate/pose", pose_, false);
+        register_input("/referee/communicate/target", target_, false);
+        register_input("/referee/communicate/target_id", target_id_, false);
+        register_input("/referee/communicate/flags", flags_, false);
+
+        register_output("/referee/command/interaction/communicate", communicate_field_);
+    }
+
+    void update() override {
+        if (*robot_id_ == rmcs_msgs::RobotId::UNKNOWN) {
+            *communicate_field_ = Field{};
+            return;
+        }
+
+        using namespace communicate;
+        state_.present = 0;
+        if (pose_.ready()) {
+            state_.set(POSE_X, to_milli(pose_->x()));
+            state_.set(POSE_Y, to_milli(pose_->y()));
+            state_.set(POSE_YAW, to_milli(pose_->z()));
+        }
+        if (target_.ready()) {
+            state_.set(TARGET_X, to_milli(target_->x()));
+            state_.set(TARGET_Y, to_milli(target_->y()));
+        }
+        if (target_id_.ready())
+            state_.set(TARGET_ID, *target_id_);
+        if (flags_.ready())
+            state_.set(FLAGS, static_cast<int32_t>(*flags_));
+
+        if (!state_.present) {
+            *communicate_field_ = Field{};
+            return;
+        }
+
+        // Encoded when Command sends the frame, so the deltas always use the latest ack.
+        *communicate_field_ =
+            Field{[this](std::byte* buffer) { return write_communicate_field(buffer); }};
+    }
+
+private:
+    // m to mm, rad to mrad.
+    static int32_t to_milli(double value) {
+        return static_cast<int32_t>(std::lround(value * 1000.0));
+    }
+
+    size_t write_communicate_field(std::byte* buffer) {
+        size_t written = 0;
+
+        auto own_id        = static_cast<uint16_t>(*robot_id_);
+        auto receiver_id   = static_cast<uint16_t>(own_id > 100 ? receiver_ + 100 : receiver_);
+        auto& header       = *new (buffer + written) Header{};
+        header.command_id  = communicate::command_id;
+        header.sender_id   = rmcs_msgs::FullRobotId{*robot_id_};
+        header.receiver_id = receiver_id;
+        written += sizeof(Header);
+
+        uint8_t ack = 0, peer_ack = 0;
+        if (inbox_.ready()) {
+            auto& decoder = (*inbox_)[receiver_id];
+            ack           = decoder.sequence();
+            peer_ack      = decoder.ack();
+        }
+        written += encoder_.encode(state_, ack, peer_ack, buffer + written);
+
+        return written;
+    }
+
+    uint16_t receiver_;
+
+    InputInterface<rmcs_msgs::RobotId> robot_id_;
+    InputInterface<communicate::Inbox> inbox_;
+
+    InputInterface<Eigen::Vector3d> pose_; // x, y in m, yaw in rad
+    InputInterface<Eigen::Vector2d> target_;
+    InputInterface<uint16_t> target_id_;
+    InputInterface<uint32_t> flags_;
+
+    communicate::State state_;
+    communicate::Encoder encoder_;
 
-    void update() override {}
+    OutputInterface<Field> communicate_field_;
 };
 
 } // namespace rmcs_referee::command::interaction
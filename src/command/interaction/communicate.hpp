@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <bit>
+
+namespace rmcs_referee::command::interaction::communicate {
+
+// Robot-to-robot data travels as 0x0301 sub-command 0x0200.
+// The payload carries a state of integer slots, each sent as a zigzag varint delta against the
+// newest state the peer has acknowledged, or against zero while nothing is acknowledged yet.
+//
+//   sequence u8 | ack u8 | baseline u8 | varint present mask | varint changed mask | deltas...
+//
+// `ack` is the last sequence received from the peer and `baseline` the sequence the deltas are
+// relative to, 0 for none. Sequences run from 1 to 255.
+constexpr uint16_t command_id   = 0x0200;
+constexpr size_t payload_max    = 113;
+constexpr size_t slot_count     = 16;
+constexpr size_t history_length = 8;
+
+// Worst case: header, two 16-bit masks and a 5-byte varint per slot.
+static_assert(3 + 3 + 3 + slot_count * 5 <= payload_max);
+
+// Slot layout shared by Communicate and Status, in fixed-point units.
+enum Slot : uint8_t {
+    POSE_X = 0, // mm
+    POSE_Y,     // mm
+    POSE_YAW,   // mrad
+    TARGET_ID,
+    TARGET_X, // mm
+    TARGET_Y, // mm
+    FLAGS,
+};
+
+struct State {
+    uint16_t present = 0;
+    std::array<int32_t, slot_count> values{};
+
+    [[nodiscard]] bool has(size_t slot) const { return present & (1u << slot); }
+    void set(size_t slot, int32_t value) {
+        present |= 1u << slot;
+        values[slot] = value;
+    }
+};
+
+inline size_t write_varint(std::byte* buffer, uint32_t value) {
+    size_t written = 0;
+    while (value >= 0x80) {
+        buffer[written++] = std::byte(value | 0x80);
+        value >>= 7;
+    }
+    buffer[written++] = std::byte(value);
+    return written;
+}
+
+inline bool read_varint(const std::byte*& data, const std::byte* end, uint32_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (data == end)
+            return false;
+        auto byte = static_cast<uint32_t>(*data++);
+        value |= (byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+constexpr uint32_t zigzag(int32_t value) {
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+constexpr int32_t unzigzag(uint32_t value) {
+    return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+}
+
+// Sent states by sequence, to find the baseline the peer acknowledged.
+class History {
+public:
+    [[nodiscard]] const State* find(uint8_t sequence) const {
+        auto& entry = entries_[sequence % history_length];
+        return sequence && entry.sequence == sequence ? &entry.state : nullptr;
+    }
+    void store(uint8_t sequence, const State& state) {
+        entries_[sequence % history_length] = {sequence, state};
+    }
+
+private:
+    struct Entry {
+        uint8_t sequence = 0;
+        State state;
+    };
+    std::array<Entry, history_length> entries_{};
+};
+
+class Encoder {
+public:
+    // `ack` is the last sequence received from the peer, `peer_ack` the last one of ours the peer
+    // has received. Returns the payload size, never more than payload_max.
+    size_t encode(const State& state, uint8_t ack, uint8_t peer_ack, std::byte* buffer) {
+        static constexpr State zero{};
+        auto baseline = history_.find(peer_ack);
+
+        sequence_ = sequence_ == 255 ? 1 : sequence_ + 1;
+        buffer[0] = std::byte(sequence_);
+        buffer[1] = std::byte(ack);
+        buffer[2] = std::byte(baseline ? peer_ack : 0);
+        size_t written = 3;
+
+        // Absent slots keep their baseline value, exactly as the decoder will rebuild them.
+        auto& base       = baseline ? *baseline : zero;
+        auto sent        = base;
+        sent.present     = state.present;
+        uint16_t changed = 0;
+        for (size_t slot = 0; slot < slot_count; ++slot) {
+            if (state.has(slot) && state.values[slot] != base.values[slot]) {
+                changed |= 1u << slot;
+                sent.values[slot] = state.values[slot];
+            }
+        }
+
+        written += write_varint(buffer + written, state.present);
+        written += write_varint(buffer + written, changed);
+        for (auto mask = changed; mask; mask &= mask - 1) {
+            auto slot = std::countr_zero(mask);
+            written += write_varint(buffer + written, zigzag(sent.values[slot] - base.values[slot]));
+        }
+
+        history_.store(sequence_, sent);
+        return written;
+    }
+
+private:
+    uint8_t sequence_ = 0;
+    History history_;
+};
+
+class Decoder {
+public:
+    // Returns false if the payload is malformed or its baseline is no longer known, in which case
+    // nothing is acknowledged and the sender keeps its older baseline.
+    bool decode(const std::byte* data, size_t size) {
+        static constexpr State zero{};
+        if (size < 3)
+            return false;
+
+        auto end      = data + size;
+        auto sequence = static_cast<uint8_t>(data[0]);
+        auto ack      = static_cast<uint8_t>(data[1]);
+        auto baseline = static_cast<uint8_t>(data[2]);
+        data += 3;
+
+        auto base = baseline ? history_.find(baseline) : &zero;
+        if (!sequence || !base)
+            return false;
+
+        uint32_t present, changed;
+        if (!read_varint(data, end, present) || !read_varint(data, end, changed))
+            return false;
+
+        State state;
+        state.present = static_cast<uint16_t>(present);
+        for (size_t slot = 0; slot < slot_count; ++slot) {
+            state.values[slot] = base->values[slot];
+            if (!(changed & (1u << slot)))
+                continue;
+            uint32_t delta;
+            if (!read_varint(data, end, delta))
+                return false;
+            state.values[slot] += unzigzag(delta);
+        }
+
+        history_.store(sequence, state);
+        state_    = state;
+        sequence_ = sequence;
+        ack_      = ack;
+        ++count_;
+        return true;
+    }
+
+    [[nodiscard]] const State& state() const { return state_; }
+    // Last sequence received, to be acknowledged back to the peer.
+    [[nodiscard]] uint8_t sequence() const { return sequence_; }
+    // Last of our sequences the peer has received.
+    [[nodiscard]] uint8_t ack() const { return ack_; }
+    [[nodiscard]] uint64_t count() const { return count_; }
+
+private:
+    History history_;
+    State state_;
+    uint8_t sequence_ = 0, ack_ = 0;
+    uint64_t count_ = 0;
+};
+
+// Decoders of the teammates, published by Status as "/referee/communicate/inbox".
+class Inbox {
+public:
+    // Robot ids of both sides share the same index, only teammates can reach us anyway.
+    Decoder& operator[](uint16_t robot_id) { return decoders_[robot_id % 100 % decoders_.size()]; }
+    const Decoder& operator[](uint16_t robot_id) const {
+        return decoders_[robot_id % 100 % decoders_.size()];
+    }
+
+private:
+    std::array<Decoder, 12> decoders_;
+};
+
+} // namespace rmcs_referee::command::interaction::communicate
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include <chrono>
+#include <cstdint>
+
+#include <rclcpp/node.hpp>
+#include <rmcs_executor/component.hpp>
+#include <rmcs_msgs/full_robot_id.hpp>
+#include <rmcs_msgs/robot_id.hpp>
+
+#include "command/field.hpp"
+#include "command/interaction/header.hpp"
+#include "command/prepared_frame.hpp"
+#include "command/tx_queue.hpp"
+#include "utility/parameter.hpp"
+
+namespace rmcs_referee::command::interaction {
+
+class SentryDecision
+    : public rmcs_executor::Component
+    , public rclcpp::Node {
+public:
+    SentryDecision()
+        : Node{
+              get_component_name(),
+              rclcpp::NodeOptions{}.automatically_declare_parameters_from_overrides(true)} {
+
+        retransmit_interval_ = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(
+                utility::get_double_parameter_or(*this, "retransmit_interval", 1.0)));
+
+        register_input("/referee/id", robot_id_);
+
+        register_input("/referee/sentry/decision/confirm_revive", confirm_revive_, false);
+        register_input("/referee/sentry/decision/buy_revive", buy_revive_, false);
+        register_input("/referee/sentry/decision/bullet_exchange", bullet_exchange_, false);
+        register_input(
+            "/referee/sentry/decision/remote_bullet_exchange", remote_bullet_exchange_, false);
+        register_input("/referee/sentry/decision/remote_hp_exchange", remote_hp_exchange_, false);
+
+        // Decisions are queued at high priority, ahead of other queued 0x0301 frames, and
+        // command::Interaction shares the 0x0301 rate between the queue and its sub-channels.
+        register_input("/referee/command/queue", queue_);
+    }
+
+    void update() override {
+        auto& queue = const_cast<TxQueue&>(*queue_);
+
+        // One decision in flight at a time, the retransmit interval counts from when it was sent.
+        if (sequence_ != TxQueue::invalid_sequence) {
+            if (!queue.sent(sequence_))
+                return;
+            sequence_            = TxQueue::invalid_sequence;
+            retransmit_deadline_ = Clock::now() + retransmit_interval_;
+        }
+
+        if (*robot_id_ == rmcs_msgs::RobotId::UNKNOWN)
+            return;
+
+        // The referee keeps the last decision, so it is only sent again when it changes, or
+        // periodically in case a frame was lost.
+        auto decision = encode_decision();
+        if (decision == sent_decision_ && Clock::now() < retransmit_deadline_)
+            return;
+
+        // The whole frame is only serialized when the decision changes, retransmits send the
+        // same bytes again. It is left alone while queued, since only one decision is in flight.
+        if (decision != sent_decision_ || frame_.empty()) {
+            auto header = Header{
+                .command_id  = 0x0120, // Sentry decision
+                .sender_id   = rmcs_msgs::FullRobotId{*robot_id_},
+                .receiver_id = 0x8080, // Referee server
+            };
+            frame_.prepare<0x0301>(header, decision);
+        }
+        sequence_ = queue.submit(0x0301, frame_.field(), TxQueue::Priority::HIGH);
+        if (sequence_ != TxQueue::invalid_sequence)
+            sent_decision_ = decision;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Bullet and exchange counts are cumulative over the match, as the protocol expects.
+    uint32_t encode_decision() const {
+        uint32_t decision = 0;
+        if (confirm_revive_.ready() && *confirm_revive_)
+            decision |= 1u << 0;
+        if (buy_revive_.ready() && *buy_revive_)
+            decision |= 1u << 1;
+        if (bullet_exchange_.ready())
+            decision |= (static_cast<uint32_t>(*bullet_exchange_) & 0x7ff) << 2;
+        if (remote_bullet_exchange_.ready())
+            decision |= (static_cast<uint32_t>(*remote_bullet_exchange_) & 0xf) << 13;
+        if (remote_hp_exchange_.ready())
+            decision |= (static_cast<uint32_t>(*remote_hp_exchange_) & 0xf) << 17;
+        return decision;
+    }
+
+    InputInterface<rmcs_msgs::RobotId> robot_id_;
+
+    InputInterface<bool> confirm_revive_;
+    InputInterface<bool> buy_revive_;
+    InputInterface<uint16_t> bullet_exchange_;
+    InputInterface<uint8_t> remote_bullet_exchange_;
+    InputInterface<uint8_t> remote_hp_exchange_;
+
+    InputInterface<TxQueue> queue_;
+    PreparedFrame frame_;
+    TxQueue::Sequence sequence_ = TxQueue::invalid_sequence;
+
+    Clock::duration retransmit_interval_;
+    Clock::time_point retransmit_deadline_;
+    uint32_t sent_decision_ = 0;
+};
+
+} // namespace rmcs_referee::command::interaction
+
+#include <pluginlib/class_list_macros.hpp>
+
+PLUGINLIB_EXPORT_CLASS(rmcs_referee::command::interaction::SentryDecision, rmcs_executor::Component)
\ No newline at end of file
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <new>
+#include <utility>
+
+#include <rmcs_msgs/full_robot_id.hpp>
+#include <rmcs_msgs/robot_id.hpp>
+
+#include "app/ui/shape/shape.hpp"
+#include "command/interaction/header.hpp"
+
+namespace rmcs_referee::command::interaction {
+
+// Writes the 0x0301 payloads of a UI client from the shapes of its context, addressed from the
+// robot to its own client. Kept apart from Ui so the packing can be exercised without an
+// executor.
+class ShapePacker {
+public:
+    using Shape = app::ui::Shape;
+
+    // Whether any shape of the context waits to be sent.
+    static bool pending(const Shape::Context& context) { return !context.scheduler_.empty(); }
+
+    // 0x0100: deletes one layer (type 1) or all of them (type 2).
+    static size_t write_resetting_field(
+        std::byte* buffer, rmcs_msgs::RobotId robot_id, uint8_t type, uint8_t layer) {
+        size_t written = 0;
+
+        auto& header       = *new (buffer + written) Header{};
+        header.command_id  = 0x0100; // Clear shapes
+        auto full_robot_id = rmcs_msgs::FullRobotId{robot_id};
+        header.sender_id   = full_robot_id;
+        header.receiver_id = full_robot_id.client();
+        written += sizeof(Header);
+
+        struct Command {
+            uint8_t type;
+            uint8_t layer;
+        };
+        auto& command = *new (buffer + written) Command{};
+        command.type  = type;
+        command.layer = layer;
+        written += sizeof(Command);
+
+        return written;
+    }
+
+    // 0x0101-0x0104 or 0x0110: the next shapes of the run queue.
+    size_t write_updating_field(
+        std::byte* buffer, Shape::Context& context, rmcs_msgs::RobotId robot_id) {
+        size_t written = 0;
+
+        auto& header       = *new (buffer + written) Header{};
+        auto full_robot_id = rmcs_msgs::FullRobotId{robot_id};
+        header.sender_id   = full_robot_id;
+        header.receiver_id = full_robot_id.client();
+        written += sizeof(Header);
+
+        // Text shapes need a whole 0x0110 packet each. They take every other turn while shapes
+        // are also pending, instead of waiting until they happen to be first in the queue.
+        auto [candidates, text] = look_ahead(context);
+        if (text && (text_turn_ || !candidates)) {
+            text_turn_ = false;
+            auto it    = context.scheduler_.get_update_iterator();
+            for (int visited = 0; it && visited < lookahead && !it->is_text_shape(); ++visited)
+                it.ignore();
+            if (it && it->is_text_shape()) {
+                header.command_id = 0x0110; // Draw text shape
+                return written + it.update().write(buffer + written);
+            }
+        }
+        text_turn_ = text;
+
+        auto packet       = best_packet(candidates);
+        header.command_id = packet.command_id;
+
+        int slot = 0;
+        intptr_t updated[7];
+        auto it = context.scheduler_.get_update_iterator();
+        for (int visited = 0; it && visited < lookahead && slot < packet.shape_count; ++visited) {
+            if (it->is_text_shape()) {
+                it.ignore();
+                continue;
+            }
+
+            auto operation = it->predict_update();
+            if (operation == Shape::Operation::NO_OPERATION) {
+                it.ignore();
+                continue;
+            }
+
+            // Ignore identical shapes that operate identically.
+            auto id = identification(it.get(), operation);
+            if (std::find(updated, updated + slot, id) != updated + slot) {
+                it.ignore();
+                continue;
+            }
+
+            written += it.update().write(buffer + written);
+
+            updated[slot++] = id;
+        }
+
+        // Only when updating changed what the look-ahead saw.
+        for (; slot < packet.shape_count; ++slot)
+            written += Shape::no_operation_description().write(buffer + written);
+
+        return written;
+    }
+
+private:
+    struct PacketType {
+        int shape_count;
+        uint16_t command_id;
+    };
+    static constexpr PacketType packet_types[4] = {
+        {1, 0x0101}, // Draw 1 shape
+        {2, 0x0102}, // Draw 2 shapes
+        {5, 0x0103}, // Draw 5 shapes
+        {7, 0x0104}, // Draw 7 shapes
+    };
+    // Frame header, command id, crc16 and interaction header, then 15 bytes per shape.
+    static constexpr int packet_overhead = 5 + 2 + 2 + sizeof(Header);
+    static constexpr int shape_size      = 15;
+    // How far down the run queue the packer looks for shapes to send together.
+    static constexpr int lookahead = 32;
+
+    // Shapes are always aligned, so the last bits can be used to store information.
+    static intptr_t identification(const Shape* shape, Shape::Operation operation) {
+        return reinterpret_cast<intptr_t>(shape) | (operation == Shape::Operation::ADD);
+    }
+
+    // Walks the run queue without updating anything: counts the distinct shapes that would do
+    // something, up to a full packet, and whether a text shape is waiting.
+    static std::pair<int, bool> look_ahead(Shape::Context& context) {
+        int candidates = 0;
+        bool text      = false;
+        intptr_t seen[7];
+        auto it = context.scheduler_.get_update_iterator();
+        for (int visited = 0; it && visited < lookahead && (candidates < 7 || !text); ++visited) {
+            if (it->is_text_shape()) {
+                text = true;
+            } else if (auto operation = it->predict_update();
+                       operation != Shape::Operation::NO_OPERATION && candidates < 7) {
+                auto id = identification(it.get(), operation);
+                if (std::find(seen, seen + candidates, id) == seen + candidates)
+                    seen[candidates++] = id;
+            }
+            it.ignore();
+        }
+        return {candidates, text};
+    }
+
+    // Command's link credit is counted in bytes and shared with 0x0307 and 0x0308, so the packet
+    // carrying the most useful shapes per byte wins. Ties go to the one carrying more, which also
+    // saves a frame of the 0x0301 rate. 3 pending shapes go out as a 2-shape packet and 6 as a
+    // 5-shape one, the rest waiting for the next frame instead of no-operations filling the slots.
+    static PacketType best_packet(int candidates) {
+        auto best       = packet_types[0];
+        int best_useful = std::min(best.shape_count, candidates);
+        int best_bytes  = packet_overhead + best.shape_count * shape_size;
+        for (const auto& type : packet_types) {
+            int useful = std::min(type.shape_count, candidates);
+            int bytes  = packet_overhead + type.shape_count * shape_size;
+            if (useful * best_bytes > best_useful * bytes
+                || (useful * best_bytes == best_useful * bytes && useful > best_useful)) {
+                best        = type;
+                best_useful = useful;
+                best_bytes  = bytes;
+            }
+        }
+        return best;
+    }
+
+    bool text_turn_ = false;
+};
+
+} // namespace rmcs_referee::command::interaction
\ No newline at end of file
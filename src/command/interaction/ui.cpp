@@ -1,15 +1,15 @@
-#include <algorithm>
+#include <string>
 
 #include <rclcpp/node.hpp>
 #include <rmcs_executor/component.hpp>
-#include <rmcs_msgs/full_robot_id.hpp>
 #include <rmcs_msgs/game_stage.hpp>
 #include <rmcs_msgs/keyboard.hpp>
 #include <rmcs_msgs/robot_id.hpp>
 
-#include "app/ui/shape/cfs_scheduler.hpp"
 #include "app/ui/shape/shape.hpp"
-#include "command/interaction/header.hpp"
+#include "command/interaction/shape_packer.hpp"
+#include "status/statistics.hpp"
+#include "utility/parameter.hpp"
 
 namespace rmcs_referee::command::interaction {
 using namespace app::ui;
@@ -26,8 +26,22 @@ public:
         register_input("/referee/id", robot_id_);
         register_input("/referee/game/stage", game_stage_);
         register_input("/remote/keyboard", keyboard_);
+        register_input("/referee/status/statistics", statistics_, false);
+        register_input(get_parameter_or<std::string>("context", "/referee/ui/context"), context_);
 
-        register_output("/referee/command/interaction/ui", ui_field_);
+        register_output(
+            get_parameter_or<std::string>("output", "/referee/command/interaction/ui"), ui_field_);
+
+        // Layers redrawn by a stage change or the r key, all of them by default.
+        reset_layers_ = static_cast<uint16_t>(get_parameter_or("reset_layers", 0x3ff));
+
+        // Negative: estimated from the frames Status receives, the uplink being assumed to lose
+        // about as much as the downlink.
+        loss_rate_ = utility::get_double_parameter_or(*this, "loss_rate", -1.0);
+    }
+
+    void before_updating() override {
+        context().set_loss_rate(loss_rate_ < 0 ? default_loss_rate : loss_rate_);
     }
 
     void update() override {
@@ -36,118 +50,63 @@ public:
             return;
         }
 
+        auto& shapes = context();
+
         if ((last_game_stage_ == rmcs_msgs::GameStage::UNKNOWN
              && *game_stage_ != rmcs_msgs::GameStage::UNKNOWN)
             || (last_game_stage_ != rmcs_msgs::GameStage::PREPARATION
                 && *game_stage_ == rmcs_msgs::GameStage::PREPARATION)
             || (!last_keyboard_.r && keyboard_->r)) {
-            RemoteShape<Shape>::force_revoke_all_id();
-            resetting_ = 4;
+            auto used_layers = shapes.used_layers();
+            if ((reset_layers_ & used_layers) == used_layers) {
+                // The whole HUD: one command clears every layer.
+                shapes.remote_shape_.force_revoke_all_id();
+                shapes.cancel_layer_clears();
+                resetting_ = shapes.update_times();
+            } else {
+                shapes.reset_layers(reset_layers_ & used_layers);
+            }
         }
         last_game_stage_ = *game_stage_;
         last_keyboard_   = *keyboard_;
 
+        if (loss_rate_ < 0 && statistics_.ready()) {
+            if (auto estimated = statistics_->loss_rate(); estimated >= 0)
+                shapes.set_loss_rate(estimated);
+        }
+
         if (resetting_) {
             *ui_field_ = Field{[this](std::byte* buffer) {
                 --resetting_;
-                return write_resetting_field(buffer);
+                // Clear all layers
+                return ShapePacker::write_resetting_field(buffer, *robot_id_, 2, 0);
             }};
             return;
         }
 
-        if (CfsScheduler<Shape>::empty()) {
+        // Deleted layers must be gone before their shapes are drawn again.
+        if (shapes.has_layer_clear()) {
+            *ui_field_ = Field{[this](std::byte* buffer) {
+                return ShapePacker::write_resetting_field(
+                    buffer, *robot_id_, 1, context().take_layer_clear()); // Clear layer
+            }};
+            return;
+        }
+
+        if (!ShapePacker::pending(shapes)) {
             *ui_field_ = Field{};
             return;
         }
 
-        *ui_field_ = Field{[this](std::byte* buffer) { return write_updating_field(buffer); }};
+        *ui_field_ = Field{[this](std::byte* buffer) {
+            return packer_.write_updating_field(buffer, context(), *robot_id_);
+        }};
     }
 
 private:
-    size_t write_resetting_field(std::byte* buffer) const {
-        size_t written = 0;
-
-        auto& header       = *new (buffer + written) Header{};
-        header.command_id  = 0x0100; // Clear shapes
-        auto full_robot_id = rmcs_msgs::FullRobotId{*robot_id_};
-        header.sender_id   = full_robot_id;
-        header.receiver_id = full_robot_id.client();
-        written += sizeof(Header);
-
-        struct Command {
-            uint8_t type;
-            uint8_t layer;
-        };
-        auto& command = *new (buffer + written) Command{};
-        command.type  = 2;           // Clear all layers
-        command.layer = 0;
-        written += sizeof(Command);
-
-        return written;
-    }
-
-    size_t write_updating_field(std::byte* buffer) const {
-        size_t written = 0;
-
-        auto& header       = *new (buffer + written) Header{};
-        auto full_robot_id = rmcs_msgs::FullRobotId{*robot_id_};
-        header.sender_id   = full_robot_id;
-        header.receiver_id = full_robot_id.client();
-        written += sizeof(Header);
-
-        int slot = 0;
-        intptr_t updated[7];
-        for (auto it = CfsScheduler<Shape>::get_update_iterator(); it && slot < 7;) {
-            // Ignore text shape unless it is the first.
-            if (it->is_text_shape()) {
-                if (slot == 0) {
-                    header.command_id = 0x0110; // Draw text shape
-                    return written + it.update().write(buffer + written);
-                } else {
-                    it.ignore();
-                    continue;
-                }
-            }
-
-            auto operation = it->predict_update();
-            if (operation == Shape::Operation::NO_OPERATION) {
-                it.ignore();
-                continue;
-            }
-
-            // Shapes are always aligned, so the last bits can be used to store information.
-            auto identification =
-                reinterpret_cast<intptr_t>(it.get()) | (operation == Shape::Operation::ADD);
-            // Ignore identical shapes that operate identically.
-            if (std::find(updated, updated + slot, identification) != updated + slot) {
-                it.ignore();
-                continue;
-            }
-
-            written += it.update().write(buffer + written);
-
-            updated[slot++] = identification;
-        }
-
-        constexpr std::pair<int, uint16_t> optional_packet[4] = {
-            {1, 0x0101}, // Draw 1 shape
-            {2, 0x0102}, // Draw 2 shapes
-            {5, 0x0103}, // Draw 5 shapes
-            {7, 0x0104}, // Draw 7 shapes
-        };
-        for (const auto& [shape_count, command_id] : optional_packet) {
-            if (slot <= shape_count) {
-                for (; slot < shape_count; ++slot) {
-                    written += Shape::no_operation_description().write(buffer + written);
-                }
-                header.command_id = command_id;
-                break;
-            }
-        }
-
-        return written;
-    }
+    Shape::Context& context() const { return **context_; }
 
+    InputInterface<Shape::Context*> context_;
     InputInterface<rmcs_msgs::RobotId> robot_id_;
 
     InputInterface<rmcs_msgs::GameStage> game_stage_;
@@ -156,7 +115,14 @@ private:
     InputInterface<rmcs_msgs::Keyboard> keyboard_;
     rmcs_msgs::Keyboard last_keyboard_ = rmcs_msgs::Keyboard::zero();
 
+    // Needs 4 sends for 99% delivery, as the UI always did before the rate was measured.
+    static constexpr double default_loss_rate = 0.3;
+    InputInterface<status::ReceiveStatistics> statistics_;
+    double loss_rate_;
+
+    uint16_t reset_layers_;
     int resetting_ = 0;
+    ShapePacker packer_;
 
     OutputInterface<Field> ui_field_;
 };
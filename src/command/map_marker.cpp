@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <eigen3/Eigen/Eigen>
+
+#include <rclcpp/node.hpp>
+#include <rmcs_executor/component.hpp>
+#include <rmcs_msgs/robot_id.hpp>
+
+#include "command/field.hpp"
+#include "utility/parameter.hpp"
+
+namespace rmcs_referee::command {
+
+// Publishes the sentry path through 0x0307, shown on the operators' small map.
+class MapMarker
+    : public rmcs_executor::Component
+    , public rclcpp::Node {
+public:
+    MapMarker()
+        : Node{
+              get_component_name(),
+              rclcpp::NodeOptions{}.automatically_declare_parameters_from_overrides(true)} {
+
+        tolerance_ = utility::get_double_parameter_or(*this, "path_tolerance", 0.1);
+
+        register_input("/referee/id", robot_id_);
+
+        // Points in meters, in the referee map frame.
+        register_input("/referee/map_marker/path", path_);
+        // 1: attack, 2: defend, 3: move.
+        register_input("/referee/map_marker/intention", intention_, false);
+
+        register_output("/referee/command/map_marker", map_marker_field_);
+
+        encoded_path_.reserve(point_count);
+    }
+
+    void update() override {
+        if (*robot_id_ == rmcs_msgs::RobotId::UNKNOWN || path_->empty()) {
+            *map_marker_field_ = Field{};
+            return;
+        }
+
+        // The path is only looked at when Command sends the frame at 1hz, not every tick.
+        *map_marker_field_ = Field{[this](std::byte* buffer) { return write_map_data(buffer); }};
+    }
+
+private:
+    static constexpr size_t point_count = 50;
+
+    struct __attribute__((packed)) MapData {
+        uint8_t intention;
+        uint16_t start_position_x; // dm
+        uint16_t start_position_y;
+        int8_t delta_x[point_count - 1]; // dm, from the previous point
+        int8_t delta_y[point_count - 1];
+        uint16_t sender_id;
+    };
+    static_assert(sizeof(MapData) == 105);
+
+    size_t write_map_data(std::byte* buffer) {
+        auto intention = intention_.ready() ? *intention_ : uint8_t{3};
+        if (path_changed() || intention != map_data_.intention) {
+            resample();
+            encode(intention);
+        }
+        map_data_.sender_id = static_cast<uint16_t>(*robot_id_);
+        return write_field<0x0307>(buffer, map_data_);
+    }
+
+    bool path_changed() const {
+        auto& path = *path_;
+        if (encoded_source_size_ != path.size() || encoded_path_.empty())
+            return true;
+
+        // Only the points that were actually encoded are compared.
+        for (size_t i = 0; i < encoded_path_.size(); ++i) {
+            if ((path[source_index(i, path.size())] - encoded_path_[i]).norm() > tolerance_)
+                return true;
+        }
+        return false;
+    }
+
+    // Short paths are kept as is, longer ones sampled evenly by index, always keeping the goal.
+    static size_t source_index(size_t i, size_t size) {
+        if (size <= point_count)
+            return i;
+        return static_cast<size_t>(
+            std::lround(static_cast<double>(i * (size - 1)) / (point_count - 1)));
+    }
+
+    void resample() {
+        auto& path           = *path_;
+        encoded_source_size_ = path.size();
+        encoded_path_.clear();
+
+        for (size_t i = 0; i < std::min(path.size(), point_count); ++i)
+            encoded_path_.push_back(path[source_index(i, path.size())]);
+    }
+
+    void encode(uint8_t intention) {
+        auto to_decimeter = [](double value) {
+            return static_cast<int32_t>(std::lround(std::clamp(value * 10.0, 0.0, 65535.0)));
+        };
+
+        map_data_           = MapData{};
+        map_data_.intention = intention;
+
+        int32_t x                  = to_decimeter(encoded_path_.front().x());
+        int32_t y                  = to_decimeter(encoded_path_.front().y());
+        map_data_.start_position_x = static_cast<uint16_t>(x);
+        map_data_.start_position_y = static_cast<uint16_t>(y);
+
+        // Deltas are taken from the position reached so far, so clamped steps and rounding do not
+        // accumulate into an offset of the whole path.
+        for (size_t i = 1; i < encoded_path_.size(); ++i) {
+            auto delta_x = std::clamp(to_decimeter(encoded_path_[i].x()) - x, -128, 127);
+            auto delta_y = std::clamp(to_decimeter(encoded_path_[i].y()) - y, -128, 127);
+            map_data_.delta_x[i - 1] = static_cast<int8_t>(delta_x);
+            map_data_.delta_y[i - 1] = static_cast<int8_t>(delta_y);
+            x += delta_x;
+            y += delta_y;
+        }
+    }
+
+    double tolerance_;
+
+    InputInterface<rmcs_msgs::RobotId> robot_id_;
+    InputInterface<std::vector<Eigen::Vector2d>> path_;
+    InputInterface<uint8_t> intention_;
+
+    std::vector<Eigen::Vector2d> encoded_path_;
+    size_t encoded_source_size_ = 0;
+    MapData map_data_{};
+
+    OutputInterface<Field> map_marker_field_;
+};
+
+} // namespace rmcs_referee::command
+
+#include <pluginlib/class_list_macros.hpp>
+
+PLUGINLIB_EXPORT_CLASS(rmcs_referee::command::MapMarker, rmcs_executor::Component)
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <span>
+
+#include "command/field.hpp"
+#include "command/uplink_frame.hpp"
+#include "frame.hpp"
+
+namespace rmcs_referee::command {
+
+// Largest uplink payload, that of 0x0301.
+constexpr size_t uplink_data_max_length = max_data_length(0x0301);
+
+// A complete uplink frame serialized once, crc included, for content that is sent unchanged many
+// times: static UI elements, repeated decisions. Handed to Command with field(), it goes to the
+// transport without any serialization or crc work.
+class PreparedFrame {
+public:
+    template <uint16_t command_id, typename... Ts>
+    void prepare(const Ts&... data) {
+        static_assert(bounded_serialized_size<Ts...>, "Prepared frames must have a fixed size");
+
+        size_t data_length = write_field<command_id>(frame_.body.data, data...);
+        size_              = seal_frame(frame_, command_id, data_length);
+    }
+
+    [[nodiscard]] bool empty() const { return size_ == 0; }
+    void clear() { size_ = 0; }
+
+    [[nodiscard]] std::span<const std::byte> bytes() const {
+        return {reinterpret_cast<const std::byte*>(&frame_), size_};
+    }
+
+    // Must not be changed or destroyed while the returned field is pending.
+    [[nodiscard]] Field field() const { return empty() ? Field{} : Field::prepared(bytes()); }
+
+private:
+    struct __attribute__((packed)) {
+        FrameHeader header;
+        struct __attribute__((packed)) {
+            uint16_t command_id;
+            std::byte data[uplink_data_max_length + 2];
+        } body;
+    } frame_;
+    size_t size_ = 0;
+};
+
+} // namespace rmcs_referee::command
\ No newline at end of file
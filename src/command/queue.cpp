@@ -0,0 +1,26 @@
+#include <rmcs_executor/component.hpp>
+
+#include "command/tx_queue.hpp"
+
+namespace rmcs_referee::command {
+
+// Owns the TxQueue published as "/referee/command/queue". Producers and Command all take it as an
+// input, so it comes before every one of them, and a producer that also hands Command a channel
+// field does not depend on Command. Producers and Command are not ordered against each other
+// though: a frame submitted by a producer the executor updates after Command waits for the next
+// tick.
+class Queue : public rmcs_executor::Component {
+public:
+    Queue() { register_output("/referee/command/queue", queue_); }
+
+    void update() override {}
+
+private:
+    OutputInterface<TxQueue> queue_;
+};
+
+} // namespace rmcs_referee::command
+
+#include <pluginlib/class_list_macros.hpp>
+
+PLUGINLIB_EXPORT_CLASS(rmcs_referee::command::Queue, rmcs_executor::Component)
\ No newline at end of file
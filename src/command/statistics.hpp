@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+
+namespace rmcs_referee::command {
+
+// Uplink counters maintained by Command, published as "/referee/command/statistics".
+struct TxStatistics {
+    struct Channel {
+        uint16_t command_id = 0;
+        uint64_t sent_frames = 0;
+        uint64_t sent_bytes = 0;
+        // Ticks in which the channel had a frame pending but no token left.
+        uint64_t throttled = 0;
+        // Frames the transport did not take, to be retried.
+        uint64_t refused_frames = 0;
+        // Frames dropped for exceeding the payload limit of their command id.
+        uint64_t dropped_frames = 0;
+    };
+    static constexpr size_t channel_count = 3;
+    std::array<Channel, channel_count> channels{};
+
+    uint64_t link_bytes = 0;
+    // Bytes per second sent during the last full second, against the configured link bandwidth.
+    double achieved_bandwidth = 0;
+    double theoretical_bandwidth = 0;
+    double link_utilization = 0;
+};
+
+} // namespace rmcs_referee::command
\ No newline at end of file
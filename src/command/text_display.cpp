@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <rclcpp/node.hpp>
+#include <rmcs_executor/component.hpp>
+#include <rmcs_msgs/full_robot_id.hpp>
+#include <rmcs_msgs/robot_id.hpp>
+
+#include "command/field.hpp"
+#include "utility/parameter.hpp"
+
+namespace rmcs_referee::command {
+
+// Shows text messages on our operator client through 0x0308.
+// Every input in the `messages` parameter is a producer publishing its current message; a message
+// is encoded once, then only sent again after `dedupe_window` seconds.
+class TextDisplay
+    : public rmcs_executor::Component
+    , public rclcpp::Node {
+public:
+    TextDisplay()
+        : Node{
+              get_component_name(),
+              rclcpp::NodeOptions{}.automatically_declare_parameters_from_overrides(true)} {
+
+        dedupe_window_ = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(
+                utility::get_double_parameter_or(*this, "dedupe_window", 5.0)));
+
+        register_input("/referee/id", robot_id_);
+
+        auto names = get_parameter_or(
+            "messages", std::vector<std::string>{"/referee/text_display/message"});
+        // Interfaces must not move once registered.
+        messages_.reserve(names.size());
+        for (auto& name : names)
+            register_input(name, messages_.emplace_back(), false);
+
+        register_output("/referee/command/text_display", text_display_field_);
+    }
+
+    void update() override {
+        if (*robot_id_ == rmcs_msgs::RobotId::UNKNOWN) {
+            *text_display_field_ = Field{};
+            return;
+        }
+
+        auto now = Clock::now();
+        for (auto& message : messages_) {
+            if (!message.ready() || message->empty())
+                continue;
+
+            auto& entry = lookup(*message);
+            if (!entry.pending && now - entry.sent_at >= dedupe_window_) {
+                entry.pending   = true;
+                entry.queued_at = ++queue_counter_;
+            }
+        }
+
+        *text_display_field_ = next_pending()
+                                 ? Field{[this](std::byte* buffer) { return write_text(buffer); }}
+                                 : Field{};
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t text_length = 30; // 15 UTF-16 code units
+    static constexpr size_t cache_size  = 8;
+
+    struct Entry {
+        uint64_t hash = 0;
+        bool valid = false, pending = false;
+        uint64_t queued_at = 0, used_at = 0;
+        Clock::time_point sent_at;
+        std::array<std::byte, text_length> text;
+    };
+
+    static uint64_t hash(const std::u16string& message) {
+        uint64_t hash = 0xcbf29ce484222325; // FNV-1a
+        for (auto c : message) {
+            hash = (hash ^ (c & 0xff)) * 0x100000001b3;
+            hash = (hash ^ (c >> 8)) * 0x100000001b3;
+        }
+        return hash;
+    }
+
+    Entry& lookup(const std::u16string& message) {
+        auto key = hash(message);
+
+        Entry* victim = nullptr;
+        for (auto& entry : cache_) {
+            if (entry.valid && entry.hash == key) {
+                entry.used_at = ++use_counter_;
+                return entry;
+            }
+            // A pending message is never evicted before it was sent, unless all of them are.
+            if (!victim || (victim->pending && !entry.pending)
+                || (victim->pending == entry.pending && entry.used_at < victim->used_at))
+                victim = &entry;
+        }
+
+        auto& entry   = *victim;
+        entry         = Entry{};
+        entry.hash    = key;
+        entry.valid   = true;
+        entry.used_at = ++use_counter_;
+        encode(message, entry.text);
+        return entry;
+    }
+
+    // Truncated to the protocol length without splitting a surrogate pair, zero padded.
+    static void encode(const std::u16string& message, std::array<std::byte, text_length>& text) {
+        text.fill(std::byte{0});
+        auto length = std::min(message.size(), text_length / 2);
+        if (length < message.size() && length && (message[length - 1] & 0xfc00) == 0xd800)
+            --length;
+        for (size_t i = 0; i < length; ++i) {
+            text[2 * i]     = std::byte(message[i] & 0xff);
+            text[2 * i + 1] = std::byte(message[i] >> 8);
+        }
+    }
+
+    Entry* next_pending() {
+        Entry* next = nullptr;
+        for (auto& entry : cache_) {
+            if (entry.valid && entry.pending && (!next || entry.queued_at < next->queued_at))
+                next = &entry;
+        }
+        return next;
+    }
+
+    size_t write_text(std::byte* buffer) {
+        auto entry = next_pending();
+        if (!entry)
+            return 0;
+
+        auto full_robot_id = rmcs_msgs::FullRobotId{*robot_id_};
+        auto written       = write_field<0x0308>(
+            buffer, static_cast<uint16_t>(full_robot_id),
+            static_cast<uint16_t>(full_robot_id.client()), entry->text);
+
+        entry->pending = false;
+        entry->sent_at = Clock::now();
+        return written;
+    }
+
+    Clock::duration dedupe_window_;
+
+    InputInterface<rmcs_msgs::RobotId> robot_id_;
+    std::vector<InputInterface<std::u16string>> messages_;
+
+    std::array<Entry, cache_size> cache_{};
+    uint64_t queue_counter_ = 0, use_counter_ = 0;
+
+    OutputInterface<Field> text_display_field_;
+};
+
+} // namespace rmcs_referee::command
+
+#include <pluginlib/class_list_macros.hpp>
+
+PLUGINLIB_EXPORT_CLASS(rmcs_referee::command::TextDisplay, rmcs_executor::Component)
\ No newline at end of file
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <utility>
+
+#include "command/field.hpp"
+
+namespace rmcs_referee::command {
+
+// Bounded queue of one-shot frames, published by command::Queue as "/referee/command/queue".
+// Any component may submit several frames per tick; each submission gets a sequence number the
+// producer can poll to learn when its frame has been written to the link.
+// Components are updated one after another by the executor, so no locking is needed.
+class TxQueue {
+public:
+    using Sequence = uint32_t;
+    // Returned by submit() when the queue is full, the field empty or the command id not one
+    // Command sends.
+    static constexpr Sequence invalid_sequence = 0;
+
+    enum class Priority : uint8_t { HIGH = 0, NORMAL = 1, LOW = 2 };
+
+    static constexpr size_t capacity = 32;
+
+    Sequence submit(uint16_t command_id, Field field, Priority priority = Priority::NORMAL) {
+        if (!sent_by_command(command_id) || field.empty() || size_ == capacity)
+            return invalid_sequence;
+
+        for (auto& entry : entries_) {
+            if (entry.sequence != invalid_sequence)
+                continue;
+            entry = {next_sequence_, command_id, priority, std::move(field)};
+            ++size_;
+            if (++next_sequence_ == invalid_sequence)
+                ++next_sequence_;
+            return entry.sequence;
+        }
+        return invalid_sequence;
+    }
+
+    // Whether the frame has left the queue and been written to the link.
+    [[nodiscard]] bool sent(Sequence sequence) const {
+        if (sequence == invalid_sequence || !issued(sequence))
+            return false;
+        for (const auto& entry : entries_) {
+            if (entry.sequence == sequence)
+                return false;
+        }
+        return true;
+    }
+
+    [[nodiscard]] size_t size() const { return size_; }
+    [[nodiscard]] bool empty() const { return size_ == 0; }
+
+    // Used by Command, and by command::Interaction for the 0x0301 frames it multiplexes
+
+    // Highest-priority, then oldest, frame for the command id. Returns nullptr if there is none.
+    [[nodiscard]] const Field* front(uint16_t command_id) const {
+        auto entry = find_front(command_id);
+        return entry ? &entry->field : nullptr;
+    }
+
+    // Front frame for the command id, marked as the one being written. Returns nullptr if there
+    // is none. Command settles it once the transport took the frame or refused it.
+    const Field* claim(uint16_t command_id) {
+        auto entry = find_front(command_id);
+        claimed_   = entry ? entry->sequence : invalid_sequence;
+        return entry ? &entry->field : nullptr;
+    }
+
+    // Pops the claimed frame if it was accepted, a refused one stays queued to be retried.
+    // Also releases what the field captured, instead of keeping it until the slot is reused.
+    void settle(bool accepted) {
+        auto sequence = std::exchange(claimed_, invalid_sequence);
+        if (!accepted || sequence == invalid_sequence)
+            return;
+        for (auto& entry : entries_) {
+            if (entry.sequence == sequence) {
+                entry.sequence = invalid_sequence;
+                entry.field    = Field{};
+                --size_;
+                return;
+            }
+        }
+    }
+
+private:
+    // The channels of Command, anything else would never leave the queue.
+    static constexpr bool sent_by_command(uint16_t command_id) {
+        return command_id == 0x0301 || command_id == 0x0307 || command_id == 0x0308;
+    }
+
+    struct Entry {
+        Sequence sequence = invalid_sequence;
+        uint16_t command_id;
+        Priority priority;
+        Field field;
+    };
+
+    [[nodiscard]] bool issued(Sequence sequence) const {
+        // Wrap-around safe: sequences issued within the last 2^31 submissions.
+        return static_cast<int32_t>(next_sequence_ - sequence) > 0;
+    }
+
+    const Entry* find_front(uint16_t command_id) const {
+        const Entry* front = nullptr;
+        for (const auto& entry : entries_) {
+            if (entry.sequence == invalid_sequence || entry.command_id != command_id)
+                continue;
+            if (!front || entry.priority < front->priority
+                || (entry.priority == front->priority
+                    && static_cast<int32_t>(entry.sequence - front->sequence) < 0))
+                front = &entry;
+        }
+        return front;
+    }
+    Entry* find_front(uint16_t command_id) {
+        return const_cast<Entry*>(std::as_const(*this).find_front(command_id));
+    }
+
+    std::array<Entry, capacity> entries_{};
+    size_t size_            = 0;
+    Sequence next_sequence_ = 1;
+    Sequence claimed_       = invalid_sequence;
+};
+
+} // namespace rmcs_referee::command
\ No newline at end of file
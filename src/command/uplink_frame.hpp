@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "frame.hpp"
+#include "utility/crc.hpp"
+
+namespace rmcs_referee::command {
+
+// Frame with room for the crc16 behind the largest payload, so it goes out in a single write.
+struct __attribute__((packed)) UplinkFrame : Frame {
+    std::byte crc16[2];
+};
+
+// Completes a frame whose payload was written into its body: command id, header and both crcs.
+// Returns the size of the whole frame.
+template <typename T>
+inline size_t seal_frame(T& frame, uint16_t command_id, size_t data_length) {
+    frame.body.command_id = command_id;
+
+    frame.header.sof         = sof_value;
+    frame.header.data_length = data_length;
+    frame.header.sequence    = 0;
+    utility::crc::append_crc8(frame.header);
+
+    auto frame_size = sizeof(frame.header) + sizeof(frame.body.command_id) + data_length + 2;
+    utility::crc::append_crc16(&frame, frame_size);
+    return frame_size;
+}
+
+} // namespace rmcs_referee::command
\ No newline at end of file
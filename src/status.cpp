@@ -1,15 +1,26 @@
+#include <chrono>
+#include <cinttypes>
+#include <string>
+#include <system_error>
+
 #include <eigen3/Eigen/Eigen>
 #include <rclcpp/node.hpp>
 
 #include <rmcs_executor/component.hpp>
 #include <rmcs_msgs/game_stage.hpp>
 #include <rmcs_msgs/robot_id.hpp>
-#include <serial_util/crc/dji_crc.hpp>
-#include <serial_util/package_receive.hpp>
+#include <serial/serial.h>
 #include <serial_util/tick_timer.hpp>
 
+#include "command/interaction/communicate.hpp"
+#include "command/interaction/header.hpp"
 #include "frame.hpp"
+#include "status/dispatch.hpp"
 #include "status/field.hpp"
+#include "status/frame_scanner.hpp"
+#include "status/statistics.hpp"
+#include "transport.hpp"
+#include "utility/parameter.hpp"
 
 namespace rmcs_referee {
 using namespace status;
@@ -22,22 +33,77 @@ public:
         : Node{get_component_name(), rclcpp::NodeOptions{}.automatically_declare_parameters_from_overrides(true)}
         , logger_(get_logger()) {
 
-        try {
-            register_output(
-                "/referee/serial", serial_, get_parameter("path").as_string(), 115200,
-                serial::Timeout::simpleTimeout(0));
-        } catch (serial::IOException& ex) {
-            RCLCPP_ERROR(logger_, "Unable to open serial port: %s", ex.what());
+        auto path    = get_parameter("path").as_string();
+        auto backend = get_parameter_or<std::string>("backend", "serial");
+        if (backend == "replay") {
+            // `path` is a file recorded with the `record` parameter. 11520 bytes/s is the
+            // 115200 baud link, 0 replays as fast as the parser goes.
+            auto replay = Transport::Replay{
+                path, utility::get_double_parameter_or(*this, "replay_rate", 11520.0),
+                get_parameter_or("replay_loop", false)};
+            try {
+                register_output("/referee/transport", transport_, replay);
+            } catch (std::system_error& ex) {
+                RCLCPP_ERROR(logger_, "Unable to open replay file: %s", ex.what());
+            }
+        } else if (backend == "termios") {
+            // "/referee/serial" is not available with this backend.
+            try {
+                register_output("/referee/transport", transport_, path);
+            } catch (std::system_error& ex) {
+                RCLCPP_ERROR(logger_, "Unable to open serial port: %s", ex.what());
+            }
+        } else {
+            try {
+                register_output(
+                    "/referee/serial", serial_, path, 115200, serial::Timeout::simpleTimeout(0));
+            } catch (serial::IOException& ex) {
+                RCLCPP_ERROR(logger_, "Unable to open serial port: %s", ex.what());
+            }
+            if (serial_.active())
+                register_output("/referee/transport", transport_, *serial_);
+        }
+        auto record = get_parameter_or<std::string>("record", "");
+        if (transport_.active() && !record.empty()) {
+            try {
+                transport_->start_recording(record);
+            } catch (std::system_error& ex) {
+                RCLCPP_ERROR(logger_, "Unable to open record file: %s", ex.what());
+            }
         }
+        if (transport_.active() && get_parameter_or("io_thread", false))
+            transport_->start_io_thread();
 
+        register_output("/referee/game/type", game_type_, 0);
         register_output("/referee/game/stage", game_stage_, rmcs_msgs::GameStage::UNKNOWN);
+        register_output("/referee/game/stage_remain_time", game_stage_remain_time_, 0);
 
         register_output("/referee/id", robot_id_, rmcs_msgs::RobotId::UNKNOWN);
+        register_output("/referee/level", robot_level_, 0);
+        register_output("/referee/hp", robot_hp_, 0);
+        register_output("/referee/max_hp", robot_max_hp_, 0);
         register_output("/referee/shooter/cooling", robot_shooter_cooling_, 0);
         register_output("/referee/shooter/heat_limit", robot_shooter_heat_limit_, 0);
         register_output("/referee/chassis/power_limit", robot_chassis_power_limit_, 0.0);
         register_output("/referee/chassis/power", robot_chassis_power_, 0.0);
         register_output("/referee/chassis/buffer_energy", robot_buffer_energy_, 60.0);
+        register_output("/referee/chassis/voltage", robot_chassis_voltage_, 0.0);
+        register_output("/referee/chassis/current", robot_chassis_current_, 0.0);
+
+        register_output("/referee/shooter/1/heat", robot_shooter_heat_[0], 0);
+        register_output("/referee/shooter/2/heat", robot_shooter_heat_[1], 0);
+        register_output("/referee/shooter/42mm/heat", robot_shooter_heat_[2], 0);
+        register_output("/referee/shooter/1/shot", robot_shooter_shot_[0], 0);
+        register_output("/referee/shooter/2/shot", robot_shooter_shot_[1], 0);
+        register_output("/referee/shooter/42mm/shot", robot_shooter_shot_[2], 0);
+        register_output("/referee/shooter/initial_speed", robot_shooter_initial_speed_, 0.0);
+
+        register_output("/referee/hurt/armor_id", robot_hurt_armor_id_, 0);
+        register_output("/referee/hurt/reason", robot_hurt_reason_, 0);
+        register_output("/referee/hurt/count", robot_hurt_count_, 0);
+
+        register_output("/referee/position", robot_position_);
+        register_output("/referee/yaw", robot_yaw_, 0.0);
 
         register_output("/referee/friends/hero/position", pose_hero_);
         register_output("/referee/friends/engineer/position", pose_engineer_);
@@ -47,38 +113,74 @@ public:
         register_output("/referee/friends/sentry/position", pose_sentry_);
 
         register_output("/referee/robots/hp", robots_hp_);
+        register_output("/referee/sentry/hp", sentry_hp_, 0);
+        register_output("/referee/outpost/hp", outpost_hp_, 0);
+        register_output("/referee/base/hp", base_hp_, 0);
+        register_output("/referee/enemy/sentry/hp", enemy_sentry_hp_, 0);
+        register_output("/referee/enemy/outpost/hp", enemy_outpost_hp_, 0);
+        register_output("/referee/enemy/base/hp", enemy_base_hp_, 0);
+
         register_output("/referee/shooter/bullet_allowance", robot_bullet_allowance_, false);
+        register_output("/referee/shooter/42mm/bullet_allowance", robot_42mm_bullet_allowance_, 0);
+        register_output("/referee/gold_coin", robot_gold_coin_, 0);
+
+        register_output("/referee/timestamp/game_status", game_status_received_at_);
+        register_output("/referee/timestamp/game_robot_hp", game_robot_hp_received_at_);
+        register_output("/referee/timestamp/robot_status", robot_status_received_at_);
+        register_output("/referee/timestamp/power_heat_data", power_heat_data_received_at_);
+        register_output("/referee/timestamp/robot_position", robot_position_received_at_);
+        register_output("/referee/timestamp/hurt_data", hurt_data_received_at_);
+        register_output("/referee/timestamp/shoot_data", shoot_data_received_at_);
+        register_output("/referee/timestamp/bullet_allowance", bullet_allowance_received_at_);
+        register_output(
+            "/referee/timestamp/game_robot_position", game_robot_position_received_at_);
+        register_output("/referee/timestamp/interaction", interaction_received_at_);
+
+        register_output("/referee/communicate/inbox", communicate_inbox_);
+
+        register_output("/referee/status/statistics", statistics_);
+        statistics_report_interval_ = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(
+                utility::get_double_parameter_or(*this, "statistics_report_interval", 0.0)));
+        next_statistics_report_ = Clock::now() + statistics_report_interval_;
 
         robot_status_watchdog_.reset(5'000);
     }
 
     void update() override {
-        if (!serial_.active())
+        if (!transport_.active())
             return;
 
-        if (cache_size_ >= sizeof(frame_.header)) {
-            auto frame_size = sizeof(frame_.header) + sizeof(frame_.body.command_id)
-                            + frame_.header.data_length + sizeof(uint16_t);
-            cache_size_ +=
-                serial_->read(reinterpret_cast<uint8_t*>(&frame_) + cache_size_, frame_size - cache_size_);
-
-            if (cache_size_ == frame_size) {
-                cache_size_ = 0;
-                if (serial_util::dji_crc::verify_crc16(&frame_, frame_size)) {
-                    process_frame();
-                } else {
-                    RCLCPP_WARN(logger_, "Body crc16 invalid");
-                }
-            }
-        } else {
-            auto result = serial_util::receive_package(
-                *serial_, frame_.header, cache_size_, static_cast<uint8_t>(0xa5),
-                [](const FrameHeader& header) { return serial_util::dji_crc::verify_crc8(header); });
-            if (result == serial_util::ReceiveResult::HEADER_INVALID) {
-                RCLCPP_WARN(logger_, "Header start invalid");
-            } else if (result == serial_util::ReceiveResult::VERIFY_INVALID) {
-                RCLCPP_WARN(logger_, "Header crc8 invalid");
+        // Drain everything the driver has buffered, parsing in between so that a long burst
+        // never overflows the ring. Reads never block, so a short read means the kernel buffer
+        // is empty and the loop ends.
+        size_t received = 0;
+        for (int round = 0; round < max_receive_rounds; ++round) {
+            auto [first, second] = scanner_.writable();
+            auto read            = transport_->read(first, second);
+            scanner_.commit(read, Clock::now());
+            received += read;
+
+            while (scanner_.scan(frame_)) {
+                statistics_->record_frame(
+                    frame_.body.command_id, scanner_.header_received_at(), scanner_.received_at());
+                statistics_->record_sequence(frame_.header.sequence);
+                process_frame();
             }
+
+            if (read < first.size() + second.size())
+                break;
+        }
+        statistics_->record_tick(received);
+        report_statistics();
+
+        if (auto statistics = scanner_.take_statistics(); statistics.discarded_bytes) {
+            RCLCPP_WARN(
+                logger_,
+                "Resynchronized after discarding %zu bytes: %zu invalid header crc8, "
+                "%zu invalid data length, %zu invalid body crc16",
+                statistics.discarded_bytes, statistics.header_invalid, statistics.length_invalid,
+                statistics.body_invalid);
         }
 
         if (game_status_watchdog_.tick()) {
@@ -99,81 +201,166 @@ public:
     }
 
 private:
+    using Clock = std::chrono::steady_clock;
+
+    void report_statistics() {
+        if (statistics_report_interval_ <= Clock::duration::zero())
+            return;
+        auto now = Clock::now();
+        if (now < next_statistics_report_)
+            return;
+        next_statistics_report_ = now + statistics_report_interval_;
+
+        statistics_->for_each_command([this](uint16_t command_id, const auto& command) {
+            RCLCPP_INFO(
+                logger_,
+                "0x%04x: %" PRIu64 " frames, interval %.2f ms (jitter %.2f, max %.2f), "
+                "header-to-body %.2f ms (max %.2f)",
+                command_id, command.count, command.interval_mean, command.interval_jitter(),
+                command.interval_max, command.latency_mean, command.latency_max);
+        });
+
+        std::string histogram;
+        for (auto count : statistics_->bytes_per_tick())
+            histogram += std::to_string(count) + ' ';
+        RCLCPP_INFO(logger_, "Bytes per tick (log2 buckets): %s", histogram.c_str());
+
+        statistics_->reset();
+    }
+
     void process_frame() {
-        auto command_id = frame_.body.command_id;
-        if (command_id == 0x0001)
-            update_game_status();
-        if (command_id == 0x0003)
-            update_game_robot_hp();
-        else if (command_id == 0x0201)
-            update_robot_status();
-        else if (command_id == 0x0202)
-            update_power_heat_data();
-        else if (command_id == 0x0203)
-            update_robot_position();
-        else if (command_id == 0x0206)
-            update_hurt_data();
-        else if (command_id == 0x0207)
-            update_shoot_data();
-        else if (command_id == 0x0208)
-            update_bullet_allowance();
-        else if (command_id == 0x020B)
-            update_game_robot_position();
+        using Table = DispatchTable<
+            Status,
+            FrameHandler<0x0001, GameStatus, 11, &Status::update_game_status>,
+            FrameHandler<0x0003, GameRobotHp, 32, &Status::update_game_robot_hp>,
+            FrameHandler<0x0201, RobotStatus, 13, &Status::update_robot_status>,
+            FrameHandler<0x0202, PowerHeatData, 16, &Status::update_power_heat_data>,
+            FrameHandler<0x0203, RobotPosition, 12, &Status::update_robot_position>,
+            FrameHandler<0x0206, HurtData, 1, &Status::update_hurt_data>,
+            FrameHandler<0x0207, ShotData, 7, &Status::update_shoot_data>,
+            FrameHandler<0x0208, BulletAllowance, 6, &Status::update_bullet_allowance>,
+            FrameHandler<0x020B, GameRobotPosition, 40, &Status::update_game_robot_position>,
+            FrameHandler<0x0301, command::interaction::Header, 6, &Status::update_interaction>>;
+
+        auto entry = Table::find(frame_.body.command_id);
+        if (!entry)
+            return;
+
+        // Newer protocol revisions only ever append fields, so longer frames are accepted.
+        if (frame_.header.data_length < entry->length) {
+            RCLCPP_WARN(
+                logger_, "Frame 0x%04x too short: %u < %u", frame_.body.command_id,
+                frame_.header.data_length, entry->length);
+            return;
+        }
+
+        received_at_ = scanner_.received_at();
+        entry->invoke(*this, frame_.body.data);
     }
 
-    void update_game_status() {
-        auto& data = reinterpret_cast<GameStatus&>(frame_.body.data);
+    void update_game_status(const GameStatus& data) {
+        *game_status_received_at_ = received_at_;
 
-        *game_stage_ = static_cast<rmcs_msgs::GameStage>(data.game_stage);
+        *game_type_              = data.game_type;
+        *game_stage_             = static_cast<rmcs_msgs::GameStage>(data.game_stage);
+        *game_stage_remain_time_ = data.stage_remain_time;
         if (*game_stage_ == rmcs_msgs::GameStage::STARTED)
             game_status_watchdog_.reset(30'000);
         else
             game_status_watchdog_.reset(5'000);
     }
 
-    void update_game_robot_hp() {}
+    void update_game_robot_hp(const GameRobotHp& data) {
+        *game_robot_hp_received_at_ = received_at_;
+
+        *robots_hp_ = data;
+
+        // Robot ids of the blue side start from 101.
+        auto blue = static_cast<uint16_t>(*robot_id_) > 100;
+
+        *sentry_hp_        = blue ? data.blue_7 : data.red_7;
+        *outpost_hp_       = blue ? data.blue_outpost : data.red_outpost;
+        *base_hp_          = blue ? data.blue_base : data.red_base;
+        *enemy_sentry_hp_  = blue ? data.red_7 : data.blue_7;
+        *enemy_outpost_hp_ = blue ? data.red_outpost : data.blue_outpost;
+        *enemy_base_hp_    = blue ? data.red_base : data.blue_base;
+    }
+
+    void update_robot_status(const RobotStatus& data) {
+        *robot_status_received_at_ = received_at_;
 
-    void update_robot_status() {
         if (*game_stage_ == rmcs_msgs::GameStage::STARTED)
             robot_status_watchdog_.reset(60'000);
         else
             robot_status_watchdog_.reset(5'000);
 
-        auto& data = reinterpret_cast<RobotStatus&>(frame_.body.data);
-
         *robot_id_                  = static_cast<rmcs_msgs::RobotId>(data.robot_id);
+        *robot_level_               = data.robot_level;
+        *robot_hp_                  = data.current_hp;
+        *robot_max_hp_              = data.maximum_hp;
         *robot_shooter_cooling_     = data.shooter_barrel_cooling_value;
         *robot_shooter_heat_limit_  = static_cast<int64_t>(1000) * data.shooter_barrel_heat_limit;
         *robot_chassis_power_limit_ = static_cast<double>(data.chassis_power_limit);
     }
 
-    void update_power_heat_data() {
+    void update_power_heat_data(const PowerHeatData& data) {
+        *power_heat_data_received_at_ = received_at_;
+
         power_heat_data_watchdog_.reset(3'000);
 
-        auto& data            = reinterpret_cast<PowerHeatData&>(frame_.body.data);
-        *robot_chassis_power_ = data.chassis_power;
-        *robot_buffer_energy_ = static_cast<double>(data.buffer_energy);
+        *robot_chassis_power_   = data.chassis_power;
+        *robot_buffer_energy_   = static_cast<double>(data.buffer_energy);
+        *robot_chassis_voltage_ = static_cast<double>(data.chassis_voltage) / 1000.0;
+        *robot_chassis_current_ = static_cast<double>(data.chassis_current) / 1000.0;
+
+        // Heat is scaled the same way as the heat limit.
+        *robot_shooter_heat_[0] = static_cast<int64_t>(1000) * data.shooter_17mm_1_barrel_heat;
+        *robot_shooter_heat_[1] = static_cast<int64_t>(1000) * data.shooter_17mm_2_barrel_heat;
+        *robot_shooter_heat_[2] = static_cast<int64_t>(1000) * data.shooter_42mm_barrel_heat;
     }
 
-    void update_robot_position() {
-        auto& data = reinterpret_cast<RobotPosition&>(frame_.body.data);
+    void update_robot_position(const RobotPosition& data) {
+        *robot_position_received_at_ = received_at_;
+
+        robot_position_->x() = data.x;
+        robot_position_->y() = data.y;
+        *robot_yaw_          = data.angle;
 
+        // Kept for sentries reading their own position from here.
         pose_sentry_->x() = data.x;
         pose_sentry_->y() = data.y;
     }
 
-    void update_hurt_data() {}
+    void update_hurt_data(const HurtData& data) {
+        *hurt_data_received_at_ = received_at_;
+
+        *robot_hurt_armor_id_ = data.armor_id;
+        *robot_hurt_reason_   = data.reason;
+        ++*robot_hurt_count_;
+    }
+
+    void update_shoot_data(const ShotData& data) {
+        *shoot_data_received_at_ = received_at_;
+
+        // Shooter number: 1 for 17mm No.1, 2 for 17mm No.2, 3 for 42mm.
+        if (data.shooter_number < 1 || data.shooter_number > 3)
+            return;
+
+        ++*robot_shooter_shot_[data.shooter_number - 1];
+        *robot_shooter_initial_speed_ = data.initial_speed;
+    }
 
-    void update_shoot_data() {}
+    void update_bullet_allowance(const BulletAllowance& data) {
+        *bullet_allowance_received_at_ = received_at_;
 
-    void update_bullet_allowance() {
-        auto& data               = reinterpret_cast<BulletAllowance&>(frame_.body.data);
-        *robot_bullet_allowance_ = data.bullet_allowance_17mm;
+        *robot_bullet_allowance_      = data.bullet_allowance_17mm;
+        *robot_42mm_bullet_allowance_ = data.bullet_allowance_42mm;
+        *robot_gold_coin_             = data.remaining_gold_coin;
     }
 
     // @note server to sentry only
-    void update_game_robot_position() {
-        auto& data = reinterpret_cast<GameRobotPosition&>(frame_.body.data);
+    void update_game_robot_position(const GameRobotPosition& data) {
+        *game_robot_position_received_at_ = received_at_;
 
         pose_hero_->x()         = data.hero_x;
         pose_hero_->y()         = data.hero_y;
@@ -182,11 +369,26 @@ private:
         pose_infantry_iii_->x() = data.infantry_3_x;
         pose_infantry_iii_->y() = data.infantry_3_y;
         pose_infantry_iv_->x()  = data.infantry_4_x;
-        pose_infantry_iv_->y()  = data.infantry_4_x;
+        pose_infantry_iv_->y()  = data.infantry_4_y;
         pose_infantry_v_->x()   = data.infantry_5_x;
         pose_infantry_v_->y()   = data.infantry_5_y;
     }
 
+    // The header is followed by up to 113 bytes of user data.
+    void update_interaction(const command::interaction::Header& data) {
+        if (data.receiver_id != static_cast<uint16_t>(*robot_id_))
+            return;
+        *interaction_received_at_ = received_at_;
+
+        namespace communicate = command::interaction::communicate;
+        if (data.command_id == communicate::command_id) {
+            auto payload = frame_.body.data + sizeof(command::interaction::Header);
+            auto size    = frame_.header.data_length - sizeof(command::interaction::Header);
+            if (!(*communicate_inbox_)[data.sender_id].decode(payload, size))
+                RCLCPP_DEBUG(logger_, "Dropped communicate data from %u", data.sender_id);
+        }
+    }
+
     // When referee system loses connection unexpectedly,
     // use these indicators make sure the robot safe.
     // Muzzle: Cooling priority with level 1
@@ -198,20 +400,49 @@ private:
     rclcpp::Logger logger_;
 
     OutputInterface<serial::Serial> serial_;
+    OutputInterface<Transport> transport_;
+
+    static constexpr int max_receive_rounds = 4;
+    FrameScanner scanner_;
     Frame frame_;
-    size_t cache_size_ = 0;
+    Clock::time_point received_at_;
+
+    OutputInterface<ReceiveStatistics> statistics_;
+    Clock::duration statistics_report_interval_;
+    Clock::time_point next_statistics_report_;
+
+    OutputInterface<Clock::time_point> game_status_received_at_, game_robot_hp_received_at_;
+    OutputInterface<Clock::time_point> robot_status_received_at_, power_heat_data_received_at_;
+    OutputInterface<Clock::time_point> robot_position_received_at_, hurt_data_received_at_;
+    OutputInterface<Clock::time_point> shoot_data_received_at_, bullet_allowance_received_at_;
+    OutputInterface<Clock::time_point> game_robot_position_received_at_, interaction_received_at_;
 
     serial_util::TickTimer game_status_watchdog_;
+    OutputInterface<uint8_t> game_type_;
     OutputInterface<rmcs_msgs::GameStage> game_stage_;
+    OutputInterface<uint16_t> game_stage_remain_time_;
 
     serial_util::TickTimer robot_status_watchdog_;
     OutputInterface<rmcs_msgs::RobotId> robot_id_;
+    OutputInterface<uint8_t> robot_level_;
+    OutputInterface<uint16_t> robot_hp_, robot_max_hp_;
     OutputInterface<int64_t> robot_shooter_cooling_, robot_shooter_heat_limit_;
     OutputInterface<double> robot_chassis_power_limit_;
 
     serial_util::TickTimer power_heat_data_watchdog_;
     OutputInterface<double> robot_chassis_power_;
     OutputInterface<double> robot_buffer_energy_;
+    OutputInterface<double> robot_chassis_voltage_, robot_chassis_current_;
+    OutputInterface<int64_t> robot_shooter_heat_[3];
+
+    OutputInterface<uint64_t> robot_shooter_shot_[3];
+    OutputInterface<double> robot_shooter_initial_speed_;
+
+    OutputInterface<uint8_t> robot_hurt_armor_id_, robot_hurt_reason_;
+    OutputInterface<uint64_t> robot_hurt_count_;
+
+    OutputInterface<Eigen::Vector2d> robot_position_;
+    OutputInterface<double> robot_yaw_;
 
     OutputInterface<Eigen::Vector2d> pose_hero_;
     OutputInterface<Eigen::Vector2d> pose_engineer_;
@@ -221,7 +452,14 @@ private:
     OutputInterface<Eigen::Vector2d> pose_sentry_;
 
     OutputInterface<GameRobotHp> robots_hp_;
+    OutputInterface<uint16_t> sentry_hp_, outpost_hp_, base_hp_;
+    OutputInterface<uint16_t> enemy_sentry_hp_, enemy_outpost_hp_, enemy_base_hp_;
+
     OutputInterface<uint16_t> robot_bullet_allowance_;
+    OutputInterface<uint16_t> robot_42mm_bullet_allowance_;
+    OutputInterface<uint16_t> robot_gold_coin_;
+
+    OutputInterface<command::interaction::communicate::Inbox> communicate_inbox_;
 };
 
 } // namespace rmcs_referee
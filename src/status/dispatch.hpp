@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+
+namespace rmcs_referee::status {
+
+// Ids are laid out as 0xHHLL with HH < 0x04 and LL < 0x20, giving a dense 128-entry index space.
+constexpr size_t command_index_count = 0x04 * 0x20;
+
+// Returns command_index_count if the id is out of range.
+constexpr size_t command_index(uint16_t command_id) {
+    size_t high = command_id >> 8, low = command_id & 0xff;
+    if (high >= 0x04 || low >= 0x20)
+        return command_index_count;
+    return high * 0x20 + low;
+}
+
+// Binds a referee command id to its packed data struct and the member function handling it.
+// `data_length` is the length given by the protocol, checked against the struct at compile time.
+template <uint16_t id, typename Data, size_t data_length, auto handler>
+struct FrameHandler {
+    static_assert(
+        sizeof(Data) == data_length, "Packed struct does not match the protocol data length");
+    static_assert(alignof(Data) == 1, "Data structs must be packed");
+
+    static constexpr uint16_t command_id = id;
+    static constexpr uint16_t length     = data_length;
+
+    template <typename Receiver>
+    static void invoke(Receiver& receiver, const std::byte* data) {
+        (receiver.*handler)(*reinterpret_cast<const Data*>(data));
+    }
+};
+
+// Dense lookup table over all referee command ids, built at compile time.
+template <typename Receiver, typename... Handlers>
+class DispatchTable {
+public:
+    struct Entry {
+        uint16_t length                             = 0;
+        void (*invoke)(Receiver&, const std::byte*) = nullptr;
+    };
+
+    // Returns nullptr if the command id is not registered.
+    static constexpr const Entry* find(uint16_t command_id) {
+        auto i = command_index(command_id);
+        if (i == command_index_count || !table_[i].invoke)
+            return nullptr;
+        return &table_[i];
+    }
+
+private:
+    static constexpr auto table_ = [] {
+        static_assert(
+            ((command_index(Handlers::command_id) != command_index_count) && ...),
+            "Command id out of dispatch range");
+
+        std::array<Entry, command_index_count> table{};
+        bool unique = true;
+        auto insert = [&]<typename Handler>() {
+            auto& entry = table[command_index(Handler::command_id)];
+            unique &= entry.invoke == nullptr;
+            entry = {Handler::length, &Handler::template invoke<Receiver>};
+        };
+        (insert.template operator()<Handlers>(), ...);
+        if (!unique)
+            throw "Command id registered twice";
+        return table;
+    }();
+};
+
+} // namespace rmcs_referee::status
\ No newline at end of file
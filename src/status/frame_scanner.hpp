@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <array>
+#include <chrono>
+#include <span>
+
+#include "frame.hpp"
+#include "utility/crc.hpp"
+#include "utility/ring_buffer.hpp"
+
+namespace rmcs_referee::status {
+
+// Searches buffered bytes for verified frames. Every SOF is only a candidate: when its header
+// crc8, data length or body crc16 turns out to be invalid, only the SOF byte itself is dropped
+// and scanning resumes at the next candidate, so good frames behind a glitch are never lost.
+class FrameScanner {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Statistics {
+        size_t discarded_bytes;
+        size_t header_invalid;
+        size_t length_invalid;
+        size_t body_invalid;
+    };
+
+    [[nodiscard]] std::array<std::span<std::byte>, 2> writable() { return buffer_.writable_spans(); }
+    void commit(size_t size, Clock::time_point received_at) {
+        buffer_.commit(size);
+        if (size)
+            received_at_ = received_at;
+    }
+
+    // Copies the next verified frame into `frame`, returns false if more bytes are needed.
+    bool scan(Frame& frame) {
+        while (seek_sof()) {
+            if (buffer_.size() < sizeof(frame.header))
+                return false;
+
+            buffer_.copy_to(&frame.header, 0, sizeof(frame.header));
+            if (!utility::crc::verify_crc8(frame.header)) {
+                ++statistics_.header_invalid;
+                discard(1);
+                continue;
+            }
+            // The crc16 is copied along with the body, so it has to fit into `frame` as well.
+            auto frame_size = sizeof(frame.header) + sizeof(frame.body.command_id)
+                            + frame.header.data_length + sizeof(uint16_t);
+            if (frame_size > sizeof(frame)) {
+                ++statistics_.length_invalid;
+                discard(1);
+                continue;
+            }
+            if (!header_pending_) {
+                header_pending_     = true;
+                header_received_at_ = received_at_;
+            }
+            if (buffer_.size() < frame_size)
+                return false;
+
+            buffer_.copy_to(&frame, 0, frame_size);
+            if (!utility::crc::verify_crc16(&frame, frame_size)) {
+                // The header may have been a false positive inside the payload of an earlier,
+                // damaged frame. Keep the bytes and fall back to the next candidate.
+                ++statistics_.body_invalid;
+                discard(1);
+                continue;
+            }
+
+            buffer_.pop(frame_size);
+            header_pending_ = false;
+            return true;
+        }
+        return false;
+    }
+
+    // Time of the commit that completed the header of the last scanned frame.
+    [[nodiscard]] Clock::time_point header_received_at() const { return header_received_at_; }
+    // Time of the commit that completed the last scanned frame.
+    [[nodiscard]] Clock::time_point received_at() const { return received_at_; }
+
+    // Returns and clears the counters accumulated since the last call.
+    Statistics take_statistics() {
+        auto statistics = statistics_;
+        statistics_     = {};
+        return statistics;
+    }
+
+private:
+    // Drops every byte before the first SOF, returns false if the buffer runs out.
+    bool seek_sof() {
+        while (!buffer_.empty()) {
+            auto span = buffer_.contiguous_readable();
+            auto sof  = static_cast<const std::byte*>(std::memchr(span.data(), sof_value, span.size()));
+            if (sof) {
+                discard(sof - span.data());
+                return true;
+            }
+            discard(span.size());
+        }
+        return false;
+    }
+
+    void discard(size_t size) {
+        if (size)
+            header_pending_ = false;
+        statistics_.discarded_bytes += size;
+        buffer_.pop(size);
+    }
+
+    // Roughly four times the largest frame, so a whole burst fits between two reads.
+    utility::RingBuffer<4096> buffer_;
+
+    bool header_pending_ = false;
+    Clock::time_point header_received_at_, received_at_;
+
+    Statistics statistics_{};
+};
+
+} // namespace rmcs_referee::status
\ No newline at end of file
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+
+#include "status/dispatch.hpp"
+
+namespace rmcs_referee::status {
+
+// Link timing collected by Status, published as "/referee/status/statistics".
+// All durations are in milliseconds.
+class ReceiveStatistics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Command {
+        uint64_t count = 0;
+        Clock::time_point last_received_at;
+
+        // Inter-arrival time and its standard deviation (jitter), using Welford's algorithm.
+        double interval_mean = 0, interval_max = 0;
+        [[nodiscard]] double interval_jitter() const {
+            return count > 2 ? std::sqrt(interval_m2_ / static_cast<double>(count - 2)) : 0.0;
+        }
+
+        // Time between the header and the last byte of the frame reaching the executor.
+        double latency_mean = 0, latency_max = 0;
+
+    private:
+        friend class ReceiveStatistics;
+        double interval_m2_ = 0;
+    };
+
+    // Bucket i counts the ticks that received [2^(i-1), 2^i) bytes, bucket 0 counts empty ticks.
+    static constexpr size_t histogram_size = 13;
+
+    void record_frame(uint16_t command_id, Clock::time_point header_at, Clock::time_point body_at) {
+        auto index = command_index(command_id);
+        if (index == command_index_count)
+            return;
+        auto& command = commands_[index];
+
+        auto latency = to_milliseconds(body_at - header_at);
+        ++command.count;
+        command.latency_mean += (latency - command.latency_mean) / static_cast<double>(command.count);
+        command.latency_max = std::max(command.latency_max, latency);
+
+        if (command.count > 1) {
+            auto interval = to_milliseconds(body_at - command.last_received_at);
+            auto n        = static_cast<double>(command.count - 1);
+            auto delta    = interval - command.interval_mean;
+            command.interval_mean += delta / n;
+            command.interval_m2_ += delta * (interval - command.interval_mean);
+            command.interval_max = std::max(command.interval_max, interval);
+        }
+        command.last_received_at = body_at;
+    }
+
+    void record_tick(size_t received_bytes) {
+        auto bucket = std::min<size_t>(std::bit_width(received_bytes), histogram_size - 1);
+        ++bytes_per_tick_[bucket];
+    }
+
+    // Returns nullptr if no frame with this id has been received.
+    [[nodiscard]] const Command* command(uint16_t command_id) const {
+        auto index = command_index(command_id);
+        if (index == command_index_count || !commands_[index].count)
+            return nullptr;
+        return &commands_[index];
+    }
+
+    template <typename F>
+    void for_each_command(F&& callback) const {
+        for (size_t index = 0; index < command_index_count; ++index) {
+            if (commands_[index].count)
+                callback(static_cast<uint16_t>(index / 0x20 << 8 | index % 0x20), commands_[index]);
+        }
+    }
+
+    [[nodiscard]] const std::array<uint64_t, histogram_size>& bytes_per_tick() const {
+        return bytes_per_tick_;
+    }
+
+    // Frames missing between consecutive header sequence numbers count as lost. Large gaps are
+    // taken as a restart of the sender rather than as loss.
+    void record_sequence(uint8_t sequence) {
+        if (sequence_started_) {
+            auto gap = static_cast<uint8_t>(sequence - last_sequence_ - 1);
+            if (gap < max_sequence_gap) {
+                for (uint8_t i = 0; i < gap; ++i)
+                    loss_rate_ += (1.0 - loss_rate_) * loss_rate_gain;
+                loss_rate_ -= loss_rate_ * loss_rate_gain;
+                ++sequence_samples_;
+            }
+        }
+        sequence_started_ = true;
+        last_sequence_    = sequence;
+    }
+
+    // Moving average of the frame loss rate, negative until enough frames were seen.
+    [[nodiscard]] double loss_rate() const {
+        return sequence_samples_ >= min_sequence_samples ? loss_rate_ : -1.0;
+    }
+
+    // Keeps the loss rate, which is a long-term estimate rather than a per-report figure.
+    void reset() {
+        auto statistics              = ReceiveStatistics{};
+        statistics.sequence_started_ = sequence_started_;
+        statistics.last_sequence_    = last_sequence_;
+        statistics.sequence_samples_ = sequence_samples_;
+        statistics.loss_rate_        = loss_rate_;
+        *this                        = statistics;
+    }
+
+private:
+    static double to_milliseconds(Clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    static constexpr uint8_t max_sequence_gap      = 32;
+    static constexpr uint64_t min_sequence_samples = 256;
+    static constexpr double loss_rate_gain         = 1.0 / 256;
+
+    std::array<Command, command_index_count> commands_{};
+    std::array<uint64_t, histogram_size> bytes_per_tick_{};
+
+    bool sequence_started_     = false;
+    uint8_t last_sequence_     = 0;
+    uint64_t sequence_samples_ = 0;
+    double loss_rate_          = 0;
+};
+
+} // namespace rmcs_referee::status
\ No newline at end of file
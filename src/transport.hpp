@@ -0,0 +1,258 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <span>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <serial/serial.h>
+
+#include "utility/replay_port.hpp"
+#include "utility/spsc_queue.hpp"
+#include "utility/termios_port.hpp"
+
+namespace rmcs_referee {
+
+// Moves referee bytes between the executor and the serial port.
+// The port is either a serial::Serial, a raw termios fd moved with single readv/writev calls, or
+// a recorded stream played back without hardware.
+// By default every call goes straight to the port. With the io thread started, a dedicated thread
+// owns the port and the executor only touches two lock-free queues, never the kernel.
+// Status is the only reader and Command the only writer, which keeps both queues single-producer
+// single-consumer.
+class Transport {
+public:
+    explicit Transport(serial::Serial& serial)
+        : serial_(&serial) {}
+
+    explicit Transport(const std::string& path)
+        : serial_(nullptr) {
+        termios_.emplace(path, B115200);
+    }
+
+    struct Replay {
+        std::string path;
+        double rate;
+        bool loop;
+    };
+    explicit Transport(const Replay& replay)
+        : serial_(nullptr) {
+        replay_.emplace(replay.path, replay.rate, replay.loop);
+    }
+
+    Transport(const Transport&)            = delete;
+    Transport& operator=(const Transport&) = delete;
+
+    ~Transport() {
+        if (io_thread_.joinable()) {
+            running_.store(false, std::memory_order::relaxed);
+            if (termios_)
+                termios_->wakeup();
+            io_thread_.join();
+        }
+        if (record_fd_ >= 0)
+            ::close(record_fd_);
+    }
+
+    // Appends every byte read from now on to a file, in the format the replay backend plays.
+    // Must be called before start_io_thread(), which then does the writing.
+    void start_recording(const std::string& path) {
+        if (record_fd_ >= 0)
+            return;
+        record_fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (record_fd_ < 0)
+            throw std::system_error{errno, std::generic_category(), "open " + path};
+    }
+
+    void start_io_thread() {
+        // Nothing to offload from a replayed file.
+        if (io_thread_.joinable() || replay_)
+            return;
+
+        // Let the thread sleep in waitReadable() instead of spinning.
+        if (serial_)
+            serial_->setTimeout(serial::Timeout::simpleTimeout(io_thread_idle_timeout_ms));
+        running_.store(true, std::memory_order::relaxed);
+        io_thread_ = std::thread{[this] { io_thread_main(); }};
+    }
+
+    [[nodiscard]] bool io_thread_running() const { return io_thread_.joinable(); }
+
+    // Reads received bytes into up to two segments without blocking, returns the number of bytes
+    // read. The second segment is only used once the first one is full.
+    size_t read(std::span<std::byte> first, std::span<std::byte> second = {}) {
+        auto size = read_port(first, second);
+        // The io thread records what it reads itself, keeping the executor away from the kernel.
+        if (record_fd_ >= 0 && size && !io_thread_running())
+            record(first, second, size);
+        return size;
+    }
+
+    // Writes a whole frame made of up to two segments, returns false if it was not accepted.
+    // Segments are gathered by the kernel without being copied into a contiguous buffer first.
+    bool write(std::span<const std::byte> first, std::span<const std::byte> second = {}) {
+        auto size = first.size() + second.size();
+
+        if (replay_)
+            return true;
+
+        if (io_thread_running()) {
+            if (tx_queue_.writable() < size)
+                return false;
+            tx_queue_.push(first.data(), first.size());
+            tx_queue_.push(second.data(), second.size());
+            if (termios_)
+                termios_->wakeup();
+            return true;
+        }
+
+        if (termios_) {
+            if (!flush_pending())
+                return false;
+            auto written = termios_->write(first, second);
+            // Never leave a partial frame on the line: keep the rest until the kernel takes it.
+            if (written < size) {
+                for (auto segment : {first, second}) {
+                    auto skip = std::min(written, segment.size());
+                    written -= skip;
+                    pending_.push(segment.data() + skip, segment.size() - skip);
+                }
+            }
+            return true;
+        }
+
+        // serial::Serial has no gathered write, a frame should come in one segment to cost a
+        // single call.
+        auto written = serial_->write(reinterpret_cast<const uint8_t*>(first.data()), first.size());
+        if (!second.empty())
+            written += serial_->write(reinterpret_cast<const uint8_t*>(second.data()), second.size());
+        return written == size;
+    }
+
+private:
+    size_t read_port(std::span<std::byte> first, std::span<std::byte> second) {
+        if (io_thread_running()) {
+            auto size = rx_queue_.pop(first.data(), first.size());
+            if (size == first.size())
+                size += rx_queue_.pop(second.data(), second.size());
+            return size;
+        }
+        if (termios_)
+            return termios_->read(first, second);
+        if (replay_)
+            return replay_->read(first, second);
+
+        auto size = serial_->read(reinterpret_cast<uint8_t*>(first.data()), first.size());
+        if (size == first.size() && !second.empty())
+            size += serial_->read(reinterpret_cast<uint8_t*>(second.data()), second.size());
+        return size;
+    }
+
+    void record(std::span<const std::byte> first, std::span<const std::byte> second, size_t size) {
+        first  = first.first(std::min(first.size(), size));
+        second = second.first(size - first.size());
+        iovec segments[2] = {
+            {const_cast<std::byte*>(first.data()), first.size()},
+            {const_cast<std::byte*>(second.data()), second.size()},
+        };
+        [[maybe_unused]] auto result = ::writev(record_fd_, segments, second.empty() ? 1 : 2);
+    }
+
+    bool flush_pending() {
+        while (pending_.readable()) {
+            auto [first, second] = pending_.readable_spans();
+            auto written         = termios_->write(first, second);
+            if (!written)
+                return false;
+            pending_.consume(written);
+        }
+        return true;
+    }
+
+    void io_thread_main() {
+        if (termios_)
+            termios_io_loop();
+        else
+            serial_io_loop();
+    }
+
+    void serial_io_loop() {
+        while (running_.load(std::memory_order::relaxed)) {
+            bool idle = true;
+
+            if (auto available = serial_->available()) {
+                auto span = rx_queue_.contiguous_writable();
+                if (!span.empty()) {
+                    auto size = std::min(available, span.size());
+                    size      = serial_->read(reinterpret_cast<uint8_t*>(span.data()), size);
+                    if (record_fd_ >= 0 && size)
+                        record(span, {}, size);
+                    rx_queue_.commit(size);
+                    idle = false;
+                }
+            }
+
+            if (auto span = tx_queue_.contiguous_readable(); !span.empty()) {
+                tx_queue_.consume(
+                    serial_->write(reinterpret_cast<const uint8_t*>(span.data()), span.size()));
+                idle = false;
+            }
+
+            // Readability is level-triggered: with the rx queue full it would return at once.
+            if (idle) {
+                if (rx_queue_.writable())
+                    serial_->waitReadable();
+                else
+                    std::this_thread::sleep_for(
+                        std::chrono::milliseconds(io_thread_idle_timeout_ms));
+            }
+        }
+    }
+
+    void termios_io_loop() {
+        while (running_.load(std::memory_order::relaxed)) {
+            auto [rx_first, rx_second] = rx_queue_.writable_spans();
+            if (!rx_first.empty()) {
+                auto size = termios_->read(rx_first, rx_second);
+                if (record_fd_ >= 0 && size)
+                    record(rx_first, rx_second, size);
+                rx_queue_.commit(size);
+            }
+            // Until Status drains a full rx queue, pending bytes must not keep waking the thread.
+            termios_->set_read_wait(rx_queue_.writable() != 0);
+
+            auto [tx_first, tx_second] = tx_queue_.readable_spans();
+            if (!tx_first.empty())
+                tx_queue_.consume(termios_->write(tx_first, tx_second));
+
+            // Woken up by received bytes or by Command queueing a frame. The timeout only bounds
+            // the retry interval when the kernel tx buffer or the rx queue is full.
+            termios_->wait(io_thread_idle_timeout_ms);
+        }
+    }
+
+    static constexpr uint32_t io_thread_idle_timeout_ms = 1;
+
+    serial::Serial* serial_;
+    std::optional<utility::TermiosPort> termios_;
+    std::optional<utility::ReplayPort> replay_;
+    int record_fd_ = -1;
+
+    // Rest of a frame the kernel did not take at once, only used without the io thread.
+    utility::SpscByteQueue<2048> pending_;
+
+    std::atomic<bool> running_ = false;
+    std::thread io_thread_;
+
+    utility::SpscByteQueue<8192> rx_queue_;
+    utility::SpscByteQueue<4096> tx_queue_;
+};
+
+} // namespace rmcs_referee
\ No newline at end of file
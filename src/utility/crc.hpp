@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <array>
+#include <bit>
+
+namespace rmcs_referee::utility::crc {
+
+// Drop-in replacement for serial_util::dji_crc, using tables generated at compile time.
+// CRC8 only ever covers the 4-byte frame header, so a single table is enough there;
+// CRC16 covers whole frames and is computed slice-by-8.
+
+namespace detail {
+
+constexpr uint8_t crc8_polynomial   = 0x8c;   // 0x31 reflected
+constexpr uint16_t crc16_polynomial = 0x8408; // 0x1021 reflected
+
+constexpr uint8_t crc8_init   = 0xff;
+constexpr uint16_t crc16_init = 0xffff;
+
+constexpr auto crc8_table = [] {
+    std::array<uint8_t, 256> table{};
+    for (int i = 0; i < 256; ++i) {
+        auto crc = static_cast<uint8_t>(i);
+        for (int bit = 0; bit < 8; ++bit)
+            crc = (crc & 1) ? (crc >> 1) ^ crc8_polynomial : crc >> 1;
+        table[i] = crc;
+    }
+    return table;
+}();
+
+constexpr auto crc16_tables = [] {
+    std::array<std::array<uint16_t, 256>, 8> tables{};
+    for (int i = 0; i < 256; ++i) {
+        auto crc = static_cast<uint16_t>(i);
+        for (int bit = 0; bit < 8; ++bit)
+            crc = (crc & 1) ? (crc >> 1) ^ crc16_polynomial : crc >> 1;
+        tables[0][i] = crc;
+    }
+    // tables[k][i] is the crc of byte i followed by k zero bytes.
+    for (int k = 1; k < 8; ++k)
+        for (int i = 0; i < 256; ++i)
+            tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xff];
+    return tables;
+}();
+
+} // namespace detail
+
+inline uint8_t calculate_crc8(const void* data, size_t size, uint8_t crc = detail::crc8_init) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i)
+        crc = detail::crc8_table[crc ^ bytes[i]];
+    return crc;
+}
+
+inline uint16_t calculate_crc16(const void* data, size_t size, uint16_t crc = detail::crc16_init) {
+    static_assert(std::endian::native == std::endian::little);
+    const auto& t = detail::crc16_tables;
+
+    auto bytes = static_cast<const uint8_t*>(data);
+    for (; size >= 8; bytes += 8, size -= 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes, sizeof(word));
+        word ^= crc;
+        crc = t[7][word & 0xff] ^ t[6][(word >> 8) & 0xff] ^ t[5][(word >> 16) & 0xff]
+            ^ t[4][(word >> 24) & 0xff] ^ t[3][(word >> 32) & 0xff] ^ t[2][(word >> 40) & 0xff]
+            ^ t[1][(word >> 48) & 0xff] ^ t[0][word >> 56];
+    }
+    for (; size; ++bytes, --size)
+        crc = (crc >> 8) ^ t[0][(crc ^ *bytes) & 0xff];
+    return crc;
+}
+
+// The last byte of the package holds the crc8 of everything before it.
+template <typename T>
+inline bool verify_crc8(const T& package) {
+    auto bytes = reinterpret_cast<const uint8_t*>(&package);
+    return calculate_crc8(bytes, sizeof(T) - 1) == bytes[sizeof(T) - 1];
+}
+template <typename T>
+inline void append_crc8(T& package) {
+    auto bytes           = reinterpret_cast<uint8_t*>(&package);
+    bytes[sizeof(T) - 1] = calculate_crc8(bytes, sizeof(T) - 1);
+}
+
+// The last two bytes of the package hold the little-endian crc16 of everything before them.
+inline bool verify_crc16(const void* package, size_t size) {
+    if (size <= 2)
+        return false;
+    auto bytes = static_cast<const uint8_t*>(package);
+    auto crc   = calculate_crc16(bytes, size - 2);
+    return bytes[size - 2] == (crc & 0xff) && bytes[size - 1] == (crc >> 8);
+}
+inline void append_crc16(void* package, size_t size) {
+    if (size <= 2)
+        return;
+    auto bytes      = static_cast<uint8_t*>(package);
+    auto crc        = calculate_crc16(bytes, size - 2);
+    bytes[size - 2] = crc & 0xff;
+    bytes[size - 1] = crc >> 8;
+}
+
+} // namespace rmcs_referee::utility::crc
\ No newline at end of file
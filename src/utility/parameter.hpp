@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+
+#include <rclcpp/node.hpp>
+
+namespace rmcs_referee::utility {
+
+// Reads a floating point parameter. Unlike Node::get_parameter_or(), which throws when the YAML
+// value was written without a decimal point (e.g. `link_bandwidth: 4000`), integers are accepted
+// and converted.
+inline double get_double_parameter_or(
+    const rclcpp::Node& node, const std::string& name, double default_value) {
+    rclcpp::Parameter parameter;
+    if (!node.get_parameter(name, parameter))
+        return default_value;
+    if (parameter.get_type() == rclcpp::ParameterType::PARAMETER_INTEGER)
+        return static_cast<double>(parameter.as_int());
+    return parameter.as_double();
+}
+
+} // namespace rmcs_referee::utility
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <chrono>
+#include <span>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace rmcs_referee::utility {
+
+// Plays back a raw byte stream recorded from the referee port, so field problems can be
+// reproduced and the parser exercised without hardware. Transport discards written bytes.
+class ReplayPort {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // `rate` in bytes per second paces the playback like the real link, 0 plays as fast as read.
+    ReplayPort(const std::string& path, double rate, bool loop)
+        : rate_(rate)
+        , loop_(loop) {
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0)
+            throw std::system_error{errno, std::generic_category(), "open " + path};
+    }
+    ReplayPort(const ReplayPort&)            = delete;
+    ReplayPort& operator=(const ReplayPort&) = delete;
+
+    ~ReplayPort() { ::close(fd_); }
+
+    size_t read(std::span<std::byte> first, std::span<std::byte> second = {}) {
+        auto limit = first.size() + second.size();
+        if (rate_ > 0) {
+            auto now = Clock::now();
+            if (last_read_ == Clock::time_point{})
+                last_read_ = now;
+            credit_ += rate_ * std::chrono::duration<double>(now - last_read_).count();
+            credit_    = std::min(credit_, static_cast<double>(limit));
+            last_read_ = now;
+            limit      = static_cast<size_t>(credit_);
+        }
+
+        first  = first.first(std::min(first.size(), limit));
+        second = second.first(std::min(second.size(), limit - first.size()));
+        iovec segments[2] = {
+            {first.data(), first.size()},
+            {second.data(), second.size()},
+        };
+        auto result = ::readv(fd_, segments, second.empty() ? 1 : 2);
+        if (result == 0 && loop_)
+            ::lseek(fd_, 0, SEEK_SET);
+
+        auto size = result > 0 ? static_cast<size_t>(result) : 0;
+        credit_ -= static_cast<double>(size);
+        return size;
+    }
+
+private:
+    int fd_;
+    double rate_;
+    bool loop_;
+
+    double credit_ = 0;
+    Clock::time_point last_read_;
+};
+
+} // namespace rmcs_referee::utility
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <span>
+
+namespace rmcs_referee::utility {
+
+// Fixed-capacity byte ring. Indices grow monotonically and are masked on access,
+// so `in_ - out_` is always the number of buffered bytes.
+template <size_t capacity>
+class RingBuffer {
+    static_assert(capacity && !(capacity & (capacity - 1)), "Capacity must be a power of 2");
+
+public:
+    [[nodiscard]] static constexpr size_t max_size() { return capacity; }
+
+    [[nodiscard]] size_t size() const { return in_ - out_; }
+    [[nodiscard]] size_t writable() const { return capacity - size(); }
+    [[nodiscard]] bool empty() const { return in_ == out_; }
+
+    // Largest contiguous free region starting at the write position.
+    [[nodiscard]] std::span<std::byte> contiguous_writable() {
+        auto offset = in_ & mask;
+        return {buffer_ + offset, std::min(writable(), capacity - offset)};
+    }
+    // Whole free space as two segments, the second one is empty unless the space wraps around.
+    [[nodiscard]] std::array<std::span<std::byte>, 2> writable_spans() {
+        auto first = contiguous_writable();
+        return {first, std::span<std::byte>{buffer_, writable() - first.size()}};
+    }
+    void commit(size_t size) { in_ += size; }
+
+    // Largest contiguous readable region starting at `offset` bytes past the read position.
+    [[nodiscard]] std::span<const std::byte> contiguous_readable(size_t offset = 0) const {
+        if (offset >= size())
+            return {};
+        auto begin = (out_ + offset) & mask;
+        return {buffer_ + begin, std::min(size() - offset, capacity - begin)};
+    }
+
+    [[nodiscard]] std::byte operator[](size_t offset) const { return buffer_[(out_ + offset) & mask]; }
+
+    // Requirement: offset + size <= this->size()
+    void copy_to(void* destination, size_t offset, size_t size) const {
+        auto begin = (out_ + offset) & mask;
+        auto first = std::min(size, capacity - begin);
+        std::memcpy(destination, buffer_ + begin, first);
+        std::memcpy(static_cast<std::byte*>(destination) + first, buffer_, size - first);
+    }
+
+    void pop(size_t size) { out_ += std::min(size, this->size()); }
+
+private:
+    static constexpr size_t mask = capacity - 1;
+
+    size_t in_ = 0, out_ = 0;
+    std::byte buffer_[capacity];
+};
+
+} // namespace rmcs_referee::utility
\ No newline at end of file
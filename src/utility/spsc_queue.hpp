@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <span>
+
+namespace rmcs_referee::utility {
+
+// Lock-free single-producer single-consumer byte queue.
+// The producer only writes `in_` and the consumer only writes `out_`, each publishing with
+// release and observing the other side with acquire. `Atomic` only changes in tests.
+template <size_t capacity, template <typename> class Atomic = std::atomic>
+class SpscByteQueue {
+    static_assert(capacity && !(capacity & (capacity - 1)), "Capacity must be a power of 2");
+
+public:
+    // Producer side
+
+    [[nodiscard]] size_t writable() const {
+        return capacity - (in_.load(std::memory_order::relaxed) - out_.load(std::memory_order::acquire));
+    }
+
+    [[nodiscard]] std::span<std::byte> contiguous_writable() { return writable_spans()[0]; }
+    // Whole free space as two segments, the second one is empty unless the space wraps around.
+    // The consumer index is loaded once, so that both segments describe the same free space.
+    [[nodiscard]] std::array<std::span<std::byte>, 2> writable_spans() {
+        auto in     = in_.load(std::memory_order::relaxed);
+        auto free   = capacity - (in - out_.load(std::memory_order::acquire));
+        auto offset = in & mask;
+        auto first  = std::min(free, capacity - offset);
+        return {std::span<std::byte>{buffer_ + offset, first}, {buffer_, free - first}};
+    }
+    void commit(size_t size) {
+        in_.store(in_.load(std::memory_order::relaxed) + size, std::memory_order::release);
+    }
+
+    // Pushes all bytes or nothing, returns false if there is not enough space.
+    bool push(const void* data, size_t size) {
+        if (writable() < size)
+            return false;
+
+        auto offset = in_.load(std::memory_order::relaxed) & mask;
+        auto first  = std::min(size, capacity - offset);
+        std::memcpy(buffer_ + offset, data, first);
+        std::memcpy(buffer_, static_cast<const std::byte*>(data) + first, size - first);
+        commit(size);
+        return true;
+    }
+
+    // Consumer side
+
+    [[nodiscard]] size_t readable() const {
+        return in_.load(std::memory_order::acquire) - out_.load(std::memory_order::relaxed);
+    }
+
+    [[nodiscard]] std::span<const std::byte> contiguous_readable() const {
+        return readable_spans()[0];
+    }
+    // All readable bytes as two segments, the second one is empty unless the data wraps around.
+    // The producer index is loaded once, so that both segments describe the same bytes.
+    [[nodiscard]] std::array<std::span<const std::byte>, 2> readable_spans() const {
+        auto out    = out_.load(std::memory_order::relaxed);
+        auto size   = in_.load(std::memory_order::acquire) - out;
+        auto offset = out & mask;
+        auto first  = std::min(size, capacity - offset);
+        return {std::span<const std::byte>{buffer_ + offset, first}, {buffer_, size - first}};
+    }
+    void consume(size_t size) {
+        out_.store(out_.load(std::memory_order::relaxed) + size, std::memory_order::release);
+    }
+
+    // Pops up to `size` bytes, returns the number of bytes popped.
+    size_t pop(void* destination, size_t size) {
+        size_t popped = 0;
+        while (popped < size) {
+            auto span = contiguous_readable();
+            if (span.empty())
+                break;
+            auto n = std::min(span.size(), size - popped);
+            std::memcpy(static_cast<std::byte*>(destination) + popped, span.data(), n);
+            consume(n);
+            popped += n;
+        }
+        return popped;
+    }
+
+private:
+    static constexpr size_t mask = capacity - 1;
+
+    alignas(64) Atomic<size_t> in_  = 0;
+    alignas(64) Atomic<size_t> out_ = 0;
+    alignas(64) std::byte buffer_[capacity];
+};
+
+} // namespace rmcs_referee::utility
\ No newline at end of file
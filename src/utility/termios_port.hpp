@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <span>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace rmcs_referee::utility {
+
+// Raw non-blocking tty with an epoll set, used in place of serial::Serial when the
+// referee traffic needs to be moved with as few syscalls as possible.
+// Every read and write is a single readv/writev over up to two buffer segments.
+class TermiosPort {
+public:
+    TermiosPort(const std::string& path, speed_t baud_rate) {
+        fd_ = ::open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        if (fd_ < 0)
+            throw std::system_error{errno, std::generic_category(), "open " + path};
+
+        termios options;
+        if (::tcgetattr(fd_, &options) < 0)
+            throw_and_close("tcgetattr");
+        ::cfmakeraw(&options);
+        options.c_cflag |= CLOCAL | CREAD;
+        options.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+        options.c_cc[VMIN]  = 0;
+        options.c_cc[VTIME] = 0;
+        ::cfsetispeed(&options, baud_rate);
+        ::cfsetospeed(&options, baud_rate);
+        if (::tcsetattr(fd_, TCSANOW, &options) < 0)
+            throw_and_close("tcsetattr");
+        ::tcflush(fd_, TCIOFLUSH);
+
+        wakeup_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        epoll_fd_  = ::epoll_create1(EPOLL_CLOEXEC);
+        if (wakeup_fd_ < 0 || epoll_fd_ < 0)
+            throw_and_close("epoll");
+
+        epoll_event event{};
+        event.events  = EPOLLIN;
+        event.data.fd = fd_;
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd_, &event) < 0)
+            throw_and_close("epoll_ctl");
+        event.data.fd = wakeup_fd_;
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &event) < 0)
+            throw_and_close("epoll_ctl");
+    }
+    TermiosPort(const TermiosPort&)            = delete;
+    TermiosPort& operator=(const TermiosPort&) = delete;
+
+    ~TermiosPort() { close(); }
+
+    // Reads into up to two segments with one readv, never blocks.
+    size_t read(std::span<std::byte> first, std::span<std::byte> second = {}) {
+        iovec segments[2] = {
+            {first.data(), first.size()},
+            {second.data(), second.size()},
+        };
+        auto result = ::readv(fd_, segments, second.empty() ? 1 : 2);
+        return result > 0 ? static_cast<size_t>(result) : 0;
+    }
+
+    // Writes up to two segments with one writev, never blocks.
+    // Returns the number of bytes written, which may be less than requested when the kernel
+    // buffer is full.
+    size_t write(std::span<const std::byte> first, std::span<const std::byte> second = {}) {
+        iovec segments[2] = {
+            {const_cast<std::byte*>(first.data()), first.size()},
+            {const_cast<std::byte*>(second.data()), second.size()},
+        };
+        auto result = ::writev(fd_, segments, second.empty() ? 1 : 2);
+        return result > 0 ? static_cast<size_t>(result) : 0;
+    }
+
+    // Blocks until the tty is readable, wakeup() is called or the timeout expires.
+    void wait(int timeout_ms) {
+        epoll_event events[2];
+        auto count = ::epoll_wait(epoll_fd_, events, 2, timeout_ms);
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.fd == wakeup_fd_) {
+                uint64_t value;
+                [[maybe_unused]] auto result = ::read(wakeup_fd_, &value, sizeof(value));
+            }
+        }
+    }
+
+    // Makes wait() return or not when the tty is readable. EPOLLIN is level-triggered, so a reader
+    // that cannot take any more bytes has to turn it off to avoid spinning.
+    void set_read_wait(bool enabled) {
+        if (read_wait_ == enabled)
+            return;
+        epoll_event event{};
+        event.events  = enabled ? uint32_t{EPOLLIN} : 0;
+        event.data.fd = fd_;
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd_, &event) == 0)
+            read_wait_ = enabled;
+    }
+
+    // Interrupts wait() from another thread.
+    void wakeup() {
+        uint64_t value               = 1;
+        [[maybe_unused]] auto result = ::write(wakeup_fd_, &value, sizeof(value));
+    }
+
+private:
+    [[noreturn]] void throw_and_close(const char* what) {
+        auto error = errno;
+        close();
+        throw std::system_error{error, std::generic_category(), what};
+    }
+
+    void close() {
+        for (int* fd : {&epoll_fd_, &wakeup_fd_, &fd_}) {
+            if (*fd >= 0)
+                ::close(*fd);
+            *fd = -1;
+        }
+    }
+
+    int fd_ = -1, wakeup_fd_ = -1, epoll_fd_ = -1;
+    bool read_wait_ = true;
+};
+
+} // namespace rmcs_referee::utility
\ No newline at end of file
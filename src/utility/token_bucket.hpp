@@ -0,0 +1,39 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+namespace rmcs_referee::utility {
+
+// Classic token bucket: `rate` tokens per second, holding at most `burst` tokens.
+class TokenBucket {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TokenBucket() = default;
+    TokenBucket(double rate, double burst)
+        : rate_(rate)
+        , burst_(burst)
+        , tokens_(burst) {}
+
+    void refill(Clock::time_point now) {
+        if (last_refill_ != Clock::time_point{}) {
+            auto elapsed = std::chrono::duration<double>(now - last_refill_).count();
+            tokens_      = std::min(burst_, tokens_ + rate_ * elapsed);
+        }
+        last_refill_ = now;
+    }
+
+    [[nodiscard]] bool available(double tokens = 1.0) const { return tokens_ >= tokens; }
+    void consume(double tokens = 1.0) { tokens_ -= tokens; }
+
+    [[nodiscard]] double rate() const { return rate_; }
+    [[nodiscard]] double tokens() const { return tokens_; }
+
+private:
+    double rate_ = 0, burst_ = 0;
+    double tokens_ = 0;
+    Clock::time_point last_refill_;
+};
+
+} // namespace rmcs_referee::utility
\ No newline at end of file